@@ -5,9 +5,16 @@
 #include <thread>
 #include <iostream>
 #include <cassert>
-
-// Increase this if 128 threads is not enough
+#include <cstdint>
+#include <algorithm>
+#include "ThreadRegistryBitmap.hpp"
+
+// Increase this if 128 threads is not enough, or compile with -DREGISTRY_CAPACITY=N
+#ifdef REGISTRY_CAPACITY
+static const int REGISTRY_MAX_THREADS = REGISTRY_CAPACITY;
+#else
 static const int REGISTRY_MAX_THREADS = 128;
+#endif
 
 
 extern void thread_registry_deregister_thread(const int tid);
@@ -36,57 +43,51 @@ extern ThreadRegistry gThreadRegistry;
  * <h1> Registry for threads </h1>
  *
  * This is singleton type class that allows assignement of a unique id to each thread.
- * The first time a thread calls ThreadRegistry::getTID() it will allocate a free slot in 'usedTID[]'.
+ * The first time a thread calls ThreadRegistry::getTID() it will get the lowest free tid from 'tids' (see ThreadRegistryBitmap).
  * This tid wil be saved in a thread-local variable of the type ThreadCheckInCheckOut which
  * upon destruction of the thread will call the destructor of ThreadCheckInCheckOut and free the
  * corresponding slot to be used by a later thread.
+ * getMaxThreads() shrinks when threads exit, and getUsedTIDs() lets scans skip the free tids.
  * RomulusLR relies on this to work properly.
  */
 class ThreadRegistry {
 private:
-    alignas(128) std::atomic<bool>      usedTID[REGISTRY_MAX_THREADS];   // Which TIDs are in use by threads
-    alignas(128) std::atomic<int>       maxTid {-1};                     // Highest TID (+1) in use by threads
+    ThreadRegistryBitmap<REGISTRY_MAX_THREADS> tids;
 
 public:
-    ThreadRegistry() {
-        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
-            usedTID[it].store(false, std::memory_order_relaxed);
-        }
-    }
-
     /*
-     * Progress Condition: wait-free bounded (by the number of threads)
+     * Progress Condition: wait-free bounded (by the number of threads) to get the tid, lock-free to update maxTid
      */
     int register_thread_new(void) {
-        for (int tid = 0; tid < REGISTRY_MAX_THREADS; tid++) {
-            if (usedTID[tid].load(std::memory_order_acquire)) continue;
-            bool unused = false;
-            if (!usedTID[tid].compare_exchange_strong(unused, true)) continue;
-            // Increase the current maximum to cover our thread id
-            int curMax = maxTid.load();
-            while (curMax <= tid) {
-                maxTid.compare_exchange_strong(curMax, tid+1);
-                curMax = maxTid.load();
-            }
-            tl_tcico.tid = tid;
-            return tid;
+        const int tid = tids.acquire();
+        if (tid == ThreadRegistryBitmap<REGISTRY_MAX_THREADS>::NO_TID) {
+            std::cout << "ERROR: Too many threads, registry can only hold " << REGISTRY_MAX_THREADS << " threads\n";
+            assert(false);
         }
-        std::cout << "ERROR: Too many threads, registry can only hold " << REGISTRY_MAX_THREADS << " threads\n";
-        assert(false);
+        tl_tcico.tid = tid;
+        return tid;
     }
 
     /*
-     * Progress condition: wait-free population oblivious
+     * Progress condition: lock-free
      */
     inline void deregister_thread(const int tid) {
-        usedTID[tid].store(false, std::memory_order_release);
+        tids.release(tid);
     }
 
     /*
      * Progress condition: wait-free population oblivious
      */
     static inline uint64_t getMaxThreads(void) {
-        return gThreadRegistry.maxTid.load(std::memory_order_acquire);
+        return gThreadRegistry.tids.getMaxThreads();
+    }
+
+    /*
+     * Progress condition: wait-free population oblivious
+     * See ThreadRegistryBitmap::getUsedTIDs()
+     */
+    static inline uint64_t getUsedTIDs(const int w) {
+        return gThreadRegistry.tids.getUsedTIDs(w);
     }
 
     /*
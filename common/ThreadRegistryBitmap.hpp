@@ -0,0 +1,132 @@
+/******************************************************************************
+ * Copyright (c) 2016-2018, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _THREAD_REGISTRY_BITMAP_H_
+#define _THREAD_REGISTRY_BITMAP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+/*
+ * <h1> Bitmap of thread ids </h1>
+ *
+ * The part of a thread registry that hands out the tids. It is shared by common/ThreadRegistry.hpp and by the
+ * registries of the OneFile engines, which keep their own instance because their per-thread arrays are sized
+ * with their own capacity and they have their own de-registration hooks.
+ * A new thread takes the lowest free bit of 'usedTID[]'. When the thread with the highest tid leaves, maxTid
+ * goes down to the highest tid still in use, so that the scans up to getMaxThreads() get faster again when
+ * threads exit. Scans that can skip the free tids can go over the bitmap instead, with getUsedTIDs().
+ */
+template<int MAX_THREADS>
+class ThreadRegistryBitmap {
+private:
+    static const int                    WORDS = (MAX_THREADS+63)/64;
+    static const uint64_t               MAX_MASK = 0xFFFFFFFFULL;
+    alignas(128) std::atomic<uint64_t>  usedTID[WORDS];   // Bitmap of the TIDs in use by threads
+    // Highest TID (+1) in use by threads in the lower 32 bits, and a version in the upper 32 bits, incremented on
+    // each change, so that a thread lowering maxTid can't miss a registration done after it scanned the bitmap
+    alignas(128) std::atomic<uint64_t>  maxTid {0};
+
+    // Bits of word 'w' of the bitmap that have a TID below MAX_THREADS
+    static constexpr uint64_t wordMask(const int w) {
+        return (w < WORDS-1 || MAX_THREADS % 64 == 0) ? ~0ULL : (1ULL << (MAX_THREADS % 64))-1;
+    }
+
+    static inline uint64_t nextMaxTid(const uint64_t cur, const uint64_t newMax) {
+        return ((cur & ~MAX_MASK) + MAX_MASK + 1) | newMax;
+    }
+
+public:
+    static const int NO_TID = -1;
+
+    ThreadRegistryBitmap() {
+        for (int w = 0; w < WORDS; w++) usedTID[w].store(0, std::memory_order_relaxed);
+    }
+
+    /*
+     * Progress Condition: wait-free bounded (by the number of threads) to get the tid, lock-free to update maxTid
+     * Returns NO_TID if all the tids are in use.
+     */
+    int acquire(void) {
+        for (int w = 0; w < WORDS; w++) {
+            uint64_t used = usedTID[w].load(std::memory_order_acquire);
+            uint64_t tried = 0;  // We try each bit at most once, from the lowest to the highest
+            while (true) {
+                const uint64_t unused = ~(used | tried) & wordMask(w);
+                if (unused == 0) break;
+                const uint64_t bit = unused & (~unused + 1);
+                tried |= bit | (bit-1);
+                used = usedTID[w].fetch_or(bit);
+                if (used & bit) continue;
+                const int tid = w*64 + __builtin_ctzll(bit);
+                // Increase the current maximum to cover our thread id, and the version in any case
+                uint64_t curMax = maxTid.load();
+                while (!maxTid.compare_exchange_weak(curMax, nextMaxTid(curMax, std::max<uint64_t>(curMax & MAX_MASK, tid+1))));
+                return tid;
+            }
+        }
+        return NO_TID;
+    }
+
+    /*
+     * Progress condition: lock-free
+     * If we had the highest tid, maxTid goes down to the highest tid still in use. With several threads
+     * releasing at the same time it may stay higher than that, until the next release.
+     * The scan starts at our own bit, because another thread may have taken our tid after we cleared it, in
+     * which case its registration only changed the version of maxTid.
+     */
+    inline void release(const int tid) {
+        usedTID[tid/64].fetch_and(~(1ULL << (tid%64)));
+        uint64_t curMax = maxTid.load();
+        while ((curMax & MAX_MASK) == (uint64_t)tid+1) {
+            int newMax = tid+1;
+            while (newMax > 0 && (usedTID[(newMax-1)/64].load() & (1ULL << ((newMax-1)%64))) == 0) newMax--;
+            if (maxTid.compare_exchange_strong(curMax, nextMaxTid(curMax, newMax))) break;
+        }
+    }
+
+    /*
+     * Progress condition: wait-free population oblivious
+     */
+    inline uint64_t getMaxThreads(void) const {
+        return maxTid.load(std::memory_order_acquire) & MAX_MASK;
+    }
+
+    /*
+     * Progress condition: wait-free population oblivious
+     * Returns the bits of the TIDs in use from 64*w to 64*w+63. A thread that registers after this call can't
+     * have done anything yet that the caller must see, just like a thread above getMaxThreads().
+     */
+    inline uint64_t getUsedTIDs(const int w) const {
+        return usedTID[w].load(std::memory_order_acquire);
+    }
+};
+
+#endif /* _THREAD_REGISTRY_BITMAP_H_ */
@@ -19,53 +19,58 @@
  * TODO
  *
  */
-template<typename K>
+template<typename K, typename Config=ofwf::DefaultConfig>
 class OFWFResizableHashSet {
 
 private:
+    typedef ofwf::Engine<Config> TM;   // The engine with the configuration 'Config' (see ofwf::DefaultConfig)
+    template<typename X> using tmtype = typename TM::template tmtype<X>;
+
     struct Node : public ofwf::tmbase {
-        ofwf::tmtype<K>     key;
-        ofwf::tmtype<Node*> next {nullptr};
+        tmtype<K>     key;
+        tmtype<Node*> next {nullptr};
         Node(const K& k) : key{k} { } // Copy constructor for k
     };
 
-    ofwf::tmtype<uint64_t>                     capacity;
-    ofwf::tmtype<uint64_t>                     sizeHM = 0;
+    tmtype<uint64_t>                     capacity;
+    typename TM::tmcounter               sizeHM = 0;
     static constexpr double                         loadFactor = 0.75;
-    ofwf::tmtype<ofwf::tmtype<Node*>*>    buckets;      // An array of pointers to Nodes
+    tmtype<tmtype<Node*>*>    buckets;      // An array of pointers to Nodes
+
 
+    typename TM::OneFileWF& tm;   // The OneFile domain of this data structure
 
 public:
-    OFWFResizableHashSet(int maxThreads=0, uint64_t capacity=4) : capacity{capacity} {
-        ofwf::updateTx([&] () {
-            buckets = (ofwf::tmtype<Node*>*)ofwf::tmMalloc(capacity*sizeof(ofwf::tmtype<Node*>));
-            for (int i = 0; i < capacity; i++) buckets[i] = nullptr;
+    OFWFResizableHashSet(int maxThreads=0, uint64_t capacity=4, typename TM::OneFileWF& tm=TM::gOFWF) : capacity{capacity}, tm{tm} {
+        tm.updateTransaction([&] () {
+            buckets = (tmtype<Node*>*)TM::tmMalloc(capacity*sizeof(tmtype<Node*>));
+            TM::tmMemset(buckets.pload(), (Node*)nullptr, capacity);
         });
     }
 
 
     ~OFWFResizableHashSet() {
-        ofwf::updateTx([=] () {
+        tm.updateTransaction([=] () {
             for (int i = 0; i < capacity; i++){
                 Node* node = buckets[i];
                 while (node != nullptr) {
                     Node* next = node->next;
-                    ofwf::tmDelete(node);
+                    TM::tmDelete(node);
                     node = next;
                 }
             }
-            ofwf::tmFree(buckets.pload());
+            TM::tmFree(buckets.pload());
         });
     }
 
 
-    static std::string className() { return ofwf::OneFileWF::className() + "-HashMap"; }
+    static std::string className() { return TM::OneFileWF::className() + "-HashMap"; }
 
 
     void rebuild() {
         uint64_t newcapacity = 2*capacity;
-        ofwf::tmtype<Node*>* newbuckets = (ofwf::tmtype<Node*>*)ofwf::tmMalloc(newcapacity*sizeof(ofwf::tmtype<Node*>));
-        for (int i = 0; i < newcapacity; i++) newbuckets[i] = nullptr;
+        tmtype<Node*>* newbuckets = (tmtype<Node*>*)TM::tmMalloc(newcapacity*sizeof(tmtype<Node*>));
+        TM::tmMemset(newbuckets, (Node*)nullptr, newcapacity);
         for (int i = 0; i < capacity; i++) {
             Node* node = buckets[i];
             while (node!=nullptr) {
@@ -76,7 +81,7 @@ public:
                 node = next;
             }
         }
-        ofwf::tmFree(buckets.pload());
+        TM::tmFree(buckets.pload());
         buckets = newbuckets;
         capacity = newcapacity;
     }
@@ -95,7 +100,7 @@ public:
         Node* prev = node;
         while (true) {
             if (node == nullptr) {
-                Node* newnode = ofwf::tmNew<Node>(key);
+                Node* newnode = TM::template tmNew<Node>(key);
                 if (node == prev) {
                     buckets[h] = newnode;
                 } else {
@@ -130,7 +135,7 @@ public:
                     prev->next = node->next;
                 }
                 sizeHM--;
-                ofwf::tmDelete(node);
+                TM::tmDelete(node);
                 return true;
             }
             prev = node;
@@ -159,27 +164,43 @@ public:
 
     // Inserts a key only if it's not already present
     bool add(K key, const int tid=0) {
-        return ofwf::updateTx<bool>([=] () {
+        return tm.template updateTransaction<bool>([=] () {
             return innerPut(key);
         });
     }
 
     // Returns true only if the key was present
     bool remove(K key, const int tid=0) {
-        return ofwf::updateTx<bool>([=] () {
+        return tm.template updateTransaction<bool>([=] () {
             return innerRemove(key);
         });
     }
 
     bool contains(K key, const int tid=0) {
-        return ofwf::readTx<bool>([=] () {
+        return tm.template readTransaction<bool>([=] () {
             return innerGet(key);
         });
     }
 
     // Used only for benchmarks
     void addAll(K** keys, const int size, const int tid=0) {
-        for (int i = 0; i < size; i++) add(*keys[i]);
+        std::vector<K> vals(size);
+        for (int i = 0; i < size; i++) vals[i] = *keys[i];
+        tm.updateTransactionBatch(vals.data(), size, nullptr, [this] (const K& key) { return innerPut(key); });
+    }
+
+    // Batch versions of add(), remove() and contains(), which group several keys in each transaction
+    // (see OneFileWF::updateTransactionBatch()). If 'results' isn't nullptr, results[i] gets the result for keys[i].
+    void addAll(const K* keys, size_t size, bool* results) {
+        tm.updateTransactionBatch(keys, size, results, [this] (const K& key) { return innerPut(key); });
+    }
+
+    void removeAll(const K* keys, size_t size, bool* results) {
+        tm.updateTransactionBatch(keys, size, results, [this] (const K& key) { return innerRemove(key); });
+    }
+
+    void containsAll(const K* keys, size_t size, bool* results) {
+        tm.readTransactionBatch(keys, size, results, [this] (const K& key) { return innerGet(key); });
     }
 };
 
@@ -18,26 +18,83 @@
 /**
  * <h1> A Linked List Set for One-File STM (Lock-Free) </h1>
  */
-template<typename T>
+template<typename T, typename Config=oflf::DefaultConfig>
 class OFLFLinkedListSet : public oflf::tmbase {
 
 private:
+    typedef oflf::Engine<Config> TM;   // The engine with the configuration 'Config' (see oflf::DefaultConfig)
+    template<typename X> using tmtype = typename TM::template tmtype<X>;
+
     struct Node : public oflf::tmbase {
         T key {};
-        oflf::tmtype<Node*> next {nullptr};
+        tmtype<Node*> next {nullptr};
         Node() {}
         Node(T key) : key{key} { }
     };
 
-    alignas(128) oflf::tmtype<Node*>  head {nullptr};
-    alignas(128) oflf::tmtype<Node*>  tail {nullptr};
+    alignas(128) tmtype<Node*>  head {nullptr};
+    alignas(128) tmtype<Node*>  tail {nullptr};
+
+
+    typename TM::OneFileLF& tm;   // The OneFile domain of this data structure
 
+    // These are executed inside a transaction
+    bool innerAdd(T key) {
+        Node* newNode = TM::template tmNew<Node>(key);
+        Node* prev = head;
+        Node* node = prev->next;
+        Node* ltail = tail;
+        while (true) {
+            if (node == ltail) break;
+            T nkey = node->key;
+            if (key == nkey) {
+                TM::tmDelete(newNode); // If the key was already in the set, free the node that was never used
+                return false;
+            }
+            if (nkey < key) break;
+            prev = node;
+            node = node->next;
+        }
+        prev->next = newNode;
+        newNode->next = node;
+        return true;
+    }
+
+    bool innerRemove(T key) {
+        Node* prev = head;
+        Node* node = prev->next;
+        Node* ltail = tail;
+        while (true) {
+            if (node == ltail) return false;
+            T nkey = node->key;
+            if (key == nkey) {
+                prev->next = node->next;
+                TM::tmDelete(node);
+                return true;
+            }
+            if (nkey < key) return false;
+            prev = node;
+            node = node->next;
+        }
+    }
+
+    bool innerContains(T key) {
+        Node* node = head->next;
+        Node* ltail = tail;
+        while (true) {
+            if (node == ltail) return false;
+            T nkey = node->key;
+            if (key == nkey) return true;
+            if (nkey < key) return false;
+            node = node->next;
+        }
+    }
 
 public:
-    OFLFLinkedListSet(unsigned int maxThreads=0) {
-        oflf::updateTx([this] () {
-            Node* lhead = oflf::tmNew<Node>();
-            Node* ltail = oflf::tmNew<Node>();
+    OFLFLinkedListSet(unsigned int maxThreads=0, typename TM::OneFileLF& tm=TM::gOFLF) : tm{tm} {
+        tm.updateTransaction([this] () {
+            Node* lhead = TM::template tmNew<Node>();
+            Node* ltail = TM::template tmNew<Node>();
             head = lhead;
             head->next = ltail;
             tail = ltail;
@@ -46,22 +103,22 @@ public:
 
 
     ~OFLFLinkedListSet() {
-        oflf::updateTx([this] () {
+        tm.updateTransaction([this] () {
             // Delete all the nodes in the list
             Node* prev = head;
             Node* node = prev->next;
             while (node != tail) {
-                oflf::tmDelete(prev);
+                TM::tmDelete(prev);
                 prev = node;
                 node = node->next;
             }
-            oflf::tmDelete(prev);
-            oflf::tmDelete(tail.pload());
+            TM::tmDelete(prev);
+            TM::tmDelete(tail.pload());
         });
     }
 
 
-    static std::string className() { return oflf::OneFileLF::className() + "-LinkedListSet"; }
+    static std::string className() { return TM::OneFileLF::className() + "-LinkedListSet"; }
 
 
     /*
@@ -69,25 +126,8 @@ public:
      * Adds a node with a key, returns false if the key is already in the set
      */
     bool add(T key, const int tid=0) {
-        return oflf::updateTx<bool>([this,key] () -> bool {
-            Node* newNode = oflf::tmNew<Node>(key);
-            Node* prev = head;
-            Node* node = prev->next;
-            Node* ltail = tail;
-            while (true) {
-                if (node == ltail) break;
-                T nkey = node->key;
-                if (key == nkey) {
-                    oflf::tmDelete(newNode); // If the key was already in the set, free the node that was never used
-                    return false;
-                }
-                if (nkey < key) break;
-                prev = node;
-                node = node->next;
-            }
-            prev->next = newNode;
-            newNode->next = node;
-            return true;
+        return tm.template updateTransaction<bool>([this,key] () -> bool {
+            return innerAdd(key);
         });
     }
 
@@ -97,22 +137,8 @@ public:
      * Removes a node with an key, returns false if the key is not in the set
      */
     bool remove(T key, const int tid=0) {
-        return oflf::updateTx<bool>([this,key] () -> bool {
-            Node* prev = head;
-            Node* node = prev->next;
-            Node* ltail = tail;
-            while (true) {
-                if (node == ltail) return false;
-                T nkey = node->key;
-                if (key == nkey) {
-                    prev->next = node->next;
-                    oflf::tmDelete(node);
-                    return true;
-                }
-                if (nkey < key) return false;
-                prev = node;
-                node = node->next;
-            }
+        return tm.template updateTransaction<bool>([this,key] () -> bool {
+            return innerRemove(key);
         });
     }
 
@@ -122,24 +148,36 @@ public:
      * Returns true if it finds a node with a matching key
      */
     bool contains(T key, const int tid=0) {
-        return oflf::readTx<bool>([this,key] () -> bool {
-            Node* node = head->next;
-            Node* ltail = tail;
-            while (true) {
-                if (node == ltail) return false;
-                T nkey = node->key;
-                if (key == nkey) return true;
-                if (nkey < key) return false;
-                node = node->next;
-            }
+        return tm.template readTransaction<bool>([this,key] () -> bool {
+            return innerContains(key);
         });
     }
 
 
     bool addAll(T** keys, int size, const int tid) {
-        for (int i = 0; i < size; i++) add(*keys[i], tid);
+        std::vector<T> vals(size);
+        for (int i = 0; i < size; i++) vals[i] = *keys[i];
+        tm.updateTransactionBatch(vals.data(), size, nullptr, [this] (const T& key) { return innerAdd(key); });
         return true;
     }
+
+
+    /*
+     * Progress Condition: lock-free
+     * Batch versions of add(), remove() and contains(), which group several keys in each transaction
+     * (see OneFileLF::updateTransactionBatch()). If 'results' isn't nullptr, results[i] gets the result for keys[i].
+     */
+    void addAll(const T* keys, size_t size, bool* results) {
+        tm.updateTransactionBatch(keys, size, results, [this] (const T& key) { return innerAdd(key); });
+    }
+
+    void removeAll(const T* keys, size_t size, bool* results) {
+        tm.updateTransactionBatch(keys, size, results, [this] (const T& key) { return innerRemove(key); });
+    }
+
+    void containsAll(const T* keys, size_t size, bool* results) {
+        tm.readTransactionBatch(keys, size, results, [this] (const T& key) { return innerContains(key); });
+    }
 };
 
 #endif /* _ONE_FILE_LF_LINKED_LIST_SET_H_ */
@@ -30,10 +30,13 @@
  * enqueue min ops: 2 DCAS + 1 CAS
  * dequeue min ops: 1 DCAS + 1 CAS
  */
-template<typename T>
+template<typename T, typename Config=oflf::DefaultConfig>
 class OFLFArrayLinkedListQueue : public oflf::tmbase {
 
 private:
+    typedef oflf::Engine<Config> TM;   // The engine with the configuration 'Config' (see oflf::DefaultConfig)
+    template<typename X> using tmtype = typename TM::template tmtype<X>;
+
     /*
     struct cell {
         onefilelf::tmtype<T*> val;
@@ -42,26 +45,43 @@ private:
 
     struct Node : oflf::tmbase {
         static const int ITEM_NUM = 1024;   // TODO: use a larger ring buffer size here, 1024 for example
-        oflf::tmtype<uint64_t> headidx {0};
+        tmtype<uint64_t> headidx {0};
         //cell                    items[ITEM_NUM];
-        oflf::tmtype<T*>       items[ITEM_NUM];
-        oflf::tmtype<uint64_t> tailidx {0};
-        oflf::tmtype<Node*>    next {nullptr};
+        tmtype<T*>       items[ITEM_NUM];
+        tmtype<uint64_t> tailidx {0};
+        tmtype<Node*>    next {nullptr};
         Node(T* item) {
             items[0] = item;
             tailidx = 1;
             headidx = 0;
-            for (int i = 1; i < ITEM_NUM; i++) items[i] = nullptr;
+            TM::tmMemset(items+1, (T*)nullptr, ITEM_NUM-1);
         }
     };
 
-    oflf::tmtype<Node*>  head {nullptr};
-    oflf::tmtype<Node*>  tail {nullptr};
+    tmtype<Node*>  head {nullptr};
+    tmtype<Node*>  tail {nullptr};
+
 
+    typename TM::OneFileLF& tm;   // The OneFile domain of this data structure
+
+    // Executed inside a transaction
+    bool innerEnqueue(T* item) {
+        Node* ltail = tail;
+        uint64_t ltailidx = ltail->tailidx;
+        if (ltailidx < Node::ITEM_NUM) {
+            ltail->items[ltailidx] = item;
+            ++ltail->tailidx;
+            return true;
+        }
+        Node* newNode = TM::template tmNew<Node>(item);
+        tail->next = newNode;
+        tail = newNode;
+        return true;
+    }
 
 public:
-    OFLFArrayLinkedListQueue(unsigned int maxThreads=0) {
-        Node* sentinelNode = new Node(nullptr);
+    OFLFArrayLinkedListQueue(unsigned int maxThreads=0, typename TM::OneFileLF& tm=TM::gOFLF) : tm{tm} {
+        Node* sentinelNode = TM::template tmNew<Node>(nullptr);
         sentinelNode->tailidx = 0;
         head = sentinelNode;
         tail = sentinelNode;
@@ -71,7 +91,7 @@ public:
     ~OFLFArrayLinkedListQueue() {
         while (dequeue(0) != nullptr); // Drain the queue
         Node* lhead = head;
-        delete lhead;
+        TM::template tmDelete<Node>(lhead);
     }
 
 
@@ -84,27 +104,30 @@ public:
      */
     bool enqueue(T* item, const int tid=0) {
         if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
-        return oflf::updateTx<bool>([this,item] () -> bool {
-            Node* ltail = tail;
-            uint64_t ltailidx = ltail->tailidx;
-            if (ltailidx < Node::ITEM_NUM) {
-                ltail->items[ltailidx] = item;
-                ++ltail->tailidx;
-                return true;
-            }
-            Node* newNode = oflf::tmNew<Node>(item);
-            tail->next = newNode;
-            tail = newNode;
-            return true;
+        return tm.template updateTransaction<bool>([this,item] () -> bool {
+            return innerEnqueue(item);
         });
     }
 
 
+    /*
+     * Progress Condition: lock-free
+     * Batch version of enqueue(), which groups several items in each transaction (see OneFileLF::updateTransactionBatch()).
+     * If 'results' isn't nullptr, results[i] gets the result for items[i].
+     */
+    void enqueueAll(T** items, size_t size, bool* results=nullptr) {
+        for (size_t i = 0; i < size; i++) {
+            if (items[i] == nullptr) throw std::invalid_argument("item can not be nullptr");
+        }
+        tm.updateTransactionBatch(items, size, results, [this] (T* item) { return innerEnqueue(item); });
+    }
+
+
     /*
      * Progress Condition: lock-free
      */
     T* dequeue(const int tid=0) {
-        return oflf::updateTx<T*>([this] () -> T* {
+        return tm.template updateTransaction<T*>([this] () -> T* {
             Node* lhead = head;
             uint64_t lheadidx = lhead->headidx;
             // Check if queue is empty
@@ -114,7 +137,7 @@ public:
                 return lhead->items[lheadidx];
             }
             lhead = lhead->next;
-            oflf::tmDelete<Node>(head);
+            TM::template tmDelete<Node>(head);
             head = lhead;
             ++lhead->headidx;
             return lhead->items[0];
@@ -19,20 +19,33 @@
  * <h1> An Array Queue </h1>
  *
  */
-template<typename T>
+template<typename T, typename Config=oflf::DefaultConfig>
 class OFLFArrayQueue : public oflf::tmbase {
 
 private:
+    typedef oflf::Engine<Config> TM;   // The engine with the configuration 'Config' (see oflf::DefaultConfig)
+    template<typename X> using tmtype = typename TM::template tmtype<X>;
+
     static const int MAX_ITEMS = 2048;
-    oflf::tmtype<uint64_t> headidx {0};
-    oflf::tmtype<T*>       items[MAX_ITEMS];
-    oflf::tmtype<uint64_t> tailidx {0};
+    tmtype<uint64_t> headidx {0};
+    tmtype<T*>       items[MAX_ITEMS];
+    tmtype<uint64_t> tailidx {0};
+
+
+    typename TM::OneFileLF& tm;   // The OneFile domain of this data structure
 
+    // Executed inside a transaction
+    bool innerEnqueue(T* item) {
+        if (tailidx >= headidx+MAX_ITEMS) return false; // queue is full
+        items[tailidx % MAX_ITEMS] = item;
+        ++tailidx;
+        return true;
+    }
 
 public:
-    OFLFArrayQueue(unsigned int maxThreads=0) {
-        oflf::updateTx<bool>([this] () {
-            for (int i = 0; i < MAX_ITEMS; i++) items[i] = nullptr;
+    OFLFArrayQueue(unsigned int maxThreads=0, typename TM::OneFileLF& tm=TM::gOFLF) : tm{tm} {
+        tm.template updateTransaction<bool>([this] () {
+            TM::tmMemset(items, (T*)nullptr, MAX_ITEMS);
             return true;
         });
     }
@@ -50,20 +63,30 @@ public:
      */
     bool enqueue(T* item, const int tid=0) {
         if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
-        return oflf::updateTx<bool>([this,item] () -> bool {
-            if (tailidx >= headidx+MAX_ITEMS) return false; // queue is full
-            items[tailidx % MAX_ITEMS] = item;
-            ++tailidx;
-            return true;
+        return tm.template updateTransaction<bool>([this,item] () -> bool {
+            return innerEnqueue(item);
         });
     }
 
 
+    /*
+     * Progress Condition: blocking
+     * Batch version of enqueue(), which groups several items in each transaction (see OneFileLF::updateTransactionBatch()).
+     * If 'results' isn't nullptr, results[i] gets the result for items[i].
+     */
+    void enqueueAll(T** items, size_t size, bool* results=nullptr) {
+        for (size_t i = 0; i < size; i++) {
+            if (items[i] == nullptr) throw std::invalid_argument("item can not be nullptr");
+        }
+        tm.updateTransactionBatch(items, size, results, [this] (T* item) { return innerEnqueue(item); });
+    }
+
+
     /*
      * Progress Condition: blocking
      */
     T* dequeue(const int tid=0) {
-        return oflf::updateTx<T*>([this] () -> T* {
+        return tm.template updateTransaction<T*>([this] () -> T* {
             if (tailidx == headidx) return nullptr; // queue is empty
             T* item = items[headidx % MAX_ITEMS];
             ++headidx;
@@ -27,23 +27,35 @@
  * enqueue min ops: 2 DCAS + 1 CAS
  * dequeue min ops: 1 DCAS + 1 CAS
  */
-template<typename T>
+template<typename T, typename Config=oflf::DefaultConfig>
 class OFLFLinkedListQueue : public oflf::tmbase {
 
 private:
+    typedef oflf::Engine<Config> TM;   // The engine with the configuration 'Config' (see oflf::DefaultConfig)
+    template<typename X> using tmtype = typename TM::template tmtype<X>;
+
     struct Node : oflf::tmbase {
         T* item;
-        oflf::tmtype<Node*> next {nullptr};
+        tmtype<Node*> next {nullptr};
         Node(T* userItem) : item{userItem} { }
     };
 
-    oflf::tmtype<Node*>  head {nullptr};
-    oflf::tmtype<Node*>  tail {nullptr};
+    tmtype<Node*>  head {nullptr};
+    tmtype<Node*>  tail {nullptr};
+
 
+    typename TM::OneFileLF& tm;   // The OneFile domain of this data structure
+
+    // Executed inside a transaction
+    bool innerEnqueue(Node* newNode) {
+        tail->next = newNode;
+        tail = newNode;
+        return true;
+    }
 
 public:
-    OFLFLinkedListQueue(unsigned int maxThreads=0) {
-        Node* sentinelNode = oflf::tmNew<Node>(nullptr);
+    OFLFLinkedListQueue(unsigned int maxThreads=0, typename TM::OneFileLF& tm=TM::gOFLF) : tm{tm} {
+        Node* sentinelNode = TM::template tmNew<Node>(nullptr);
         head = sentinelNode;
         tail = sentinelNode;
     }
@@ -52,7 +64,7 @@ public:
     ~OFLFLinkedListQueue() {
         while (dequeue() != nullptr); // Drain the queue
         Node* lhead = head;
-        oflf::tmDelete(lhead);
+        TM::tmDelete(lhead);
     }
 
 
@@ -65,24 +77,35 @@ public:
      */
     bool enqueue(T* item, const int tid=0) {
         if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
-        Node* newNode = oflf::tmNew<Node>(item); // Let's allocate outside the transaction, less overhead
-        return oflf::updateTx<bool>([this,newNode] () -> bool {
-            tail->next = newNode;
-            tail = newNode;
-            return true;
+        Node* newNode = TM::template tmNew<Node>(item); // Let's allocate outside the transaction, less overhead
+        return tm.template updateTransaction<bool>([this,newNode] () -> bool {
+            return innerEnqueue(newNode);
         });
     }
 
 
+    /*
+     * Progress Condition: lock-free
+     * Batch version of enqueue(), which groups several items in each transaction (see OneFileLF::updateTransactionBatch()).
+     * If 'results' isn't nullptr, results[i] gets the result for items[i].
+     */
+    void enqueueAll(T** items, size_t size, bool* results=nullptr) {
+        for (size_t i = 0; i < size; i++) {
+            if (items[i] == nullptr) throw std::invalid_argument("item can not be nullptr");
+        }
+        tm.updateTransactionBatch(items, size, results, [this] (T* item) { return innerEnqueue(TM::template tmNew<Node>(item)); });
+    }
+
+
     /*
      * Progress Condition: lock-free
      */
     T* dequeue(const int tid=0) {
-        return oflf::updateTx<T*>([this] () -> T* {
+        return tm.template updateTransaction<T*>([this] () -> T* {
             Node* lhead = head;
             if (lhead == tail) return nullptr;
             head = lhead->next;
-            oflf::tmDelete(lhead);
+            TM::tmDelete(lhead);
             return head->item;
         });
     }
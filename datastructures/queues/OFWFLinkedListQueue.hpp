@@ -27,23 +27,35 @@
  * enqueue min ops: 3 DCAS + 1 CAS
  * dequeue min ops: 2 DCAS + 1 CAS
  */
-template<typename T>
+template<typename T, typename Config=ofwf::DefaultConfig>
 class OFWFLinkedListQueue : public ofwf::tmbase {
 
 private:
+    typedef ofwf::Engine<Config> TM;   // The engine with the configuration 'Config' (see ofwf::DefaultConfig)
+    template<typename X> using tmtype = typename TM::template tmtype<X>;
+
     struct Node : ofwf::tmbase {
         T* item;
-        ofwf::tmtype<Node*> next;
+        tmtype<Node*> next;
         Node(T* userItem) : item{userItem}, next{nullptr} { }
     };
 
-    ofwf::tmtype<Node*>  head {nullptr};
-    ofwf::tmtype<Node*>  tail {nullptr};
+    tmtype<Node*>  head {nullptr};
+    tmtype<Node*>  tail {nullptr};
+
 
+    typename TM::OneFileWF& tm;   // The OneFile domain of this data structure
+
+    // Executed inside a transaction
+    bool innerEnqueue(Node* newNode) {
+        tail->next = newNode;
+        tail = newNode;
+        return true;
+    }
 
 public:
-    OFWFLinkedListQueue(unsigned int maxThreads=0) {
-        Node* sentinelNode = ofwf::tmNew<Node>(nullptr);
+    OFWFLinkedListQueue(unsigned int maxThreads=0, typename TM::OneFileWF& tm=TM::gOFWF) : tm{tm} {
+        Node* sentinelNode = TM::template tmNew<Node>(nullptr);
         head = sentinelNode;
         tail = sentinelNode;
     }
@@ -52,7 +64,7 @@ public:
     ~OFWFLinkedListQueue() {
         while (dequeue() != nullptr); // Drain the queue
         Node* lhead = head;
-        ofwf::tmDelete(lhead);
+        TM::tmDelete(lhead);
     }
 
 
@@ -65,24 +77,35 @@ public:
      */
     bool enqueue(T* item, const int tid=0) {
         if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
-        Node* newNode = ofwf::tmNew<Node>(item); // Let's allocate outside the transaction, less overhead
-        return ofwf::updateTx<bool>([this,newNode] () -> bool {
-            tail->next = newNode;
-            tail = newNode;
-            return true;
+        Node* newNode = TM::template tmNew<Node>(item); // Let's allocate outside the transaction, less overhead
+        return tm.template updateTransaction<bool>([this,newNode] () -> bool {
+            return innerEnqueue(newNode);
         });
     }
 
 
+    /*
+     * Progress Condition: wait-free
+     * Batch version of enqueue(), which groups several items in each transaction (see OneFileWF::updateTransactionBatch()).
+     * If 'results' isn't nullptr, results[i] gets the result for items[i].
+     */
+    void enqueueAll(T** items, size_t size, bool* results=nullptr) {
+        for (size_t i = 0; i < size; i++) {
+            if (items[i] == nullptr) throw std::invalid_argument("item can not be nullptr");
+        }
+        tm.updateTransactionBatch(items, size, results, [this] (T* item) { return innerEnqueue(TM::template tmNew<Node>(item)); });
+    }
+
+
     /*
      * Progress Condition: wait-free bounded
      */
     T* dequeue(const int tid=0) {
-        return (T*)ofwf::updateTx<T*>([this] () -> T* {
+        return (T*)tm.template updateTransaction<T*>([this] () -> T* {
             Node* lhead = head;
             if (lhead == tail) return nullptr;
             head = lhead->next;
-            ofwf::tmDelete(lhead);
+            TM::tmDelete(lhead);
             return head->item;
         });
     }
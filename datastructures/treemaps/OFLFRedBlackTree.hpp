@@ -8,38 +8,43 @@
 #include "stms/OneFileLF.hpp"               // This header defines the macros for the STM being compiled
 
 // Adapted from Java to C++ from the original at http://algs4.cs.princeton.edu/code/edu/princeton/cs/algs4/RedBlackBST.java
-template<typename K, typename V>
+template<typename K, typename V, typename Config=oflf::DefaultConfig>
 class OFLFRedBlackTree {
+    typedef oflf::Engine<Config> TM;   // The engine with the configuration 'Config' (see oflf::DefaultConfig)
+    template<typename X> using tmtype = typename TM::template tmtype<X>;
+
     const int64_t COLOR_RED   = 0;
     const int64_t COLOR_BLACK = 1;
 
     struct Node : public oflf::tmbase {
-        oflf::tmtype<K>       key;
-        oflf::tmtype<V>       val;
-        oflf::tmtype<Node*>   left {nullptr};
-        oflf::tmtype<Node*>   right {nullptr};
-        oflf::tmtype<int64_t> color;    // color of parent link
-        oflf::tmtype<int64_t> size;     // subtree count
+        tmtype<K>       key;
+        tmtype<V>       val;
+        tmtype<Node*>   left {nullptr};
+        tmtype<Node*>   right {nullptr};
+        tmtype<int64_t> color;    // color of parent link
+        tmtype<int64_t> size;     // subtree count
         Node(const K& key, const V& val, int64_t color, int64_t size) : key{key}, val{val}, color{color}, size{size} {}
     };
 
-    oflf::tmtype<Node*> root {nullptr};   // root of the BST
+    tmtype<Node*> root {nullptr};   // root of the BST
 
-    inline void assignAndFreeIfNull(oflf::tmtype<Node*>& z, Node* w) {
+    inline void assignAndFreeIfNull(tmtype<Node*>& z, Node* w) {
         Node* tofree = z;
         z = w;
-        if (w == nullptr) oflf::tmDelete(tofree);
+        if (w == nullptr) TM::tmDelete(tofree);
     }
 
+    typename TM::OneFileLF& tm;   // The OneFile domain of this data structure
+
 public:
     /**
      * Initializes an empty symbol table.
      */
-    OFLFRedBlackTree(int numThreads=0){ }
+    OFLFRedBlackTree(int numThreads=0, typename TM::OneFileLF& tm=TM::gOFLF) : tm{tm} { }
 
     ~OFLFRedBlackTree() {
         for (int i = 0; i < 10000; i++) {
-            oflf::updateTx([&] () {
+            tm.updateTransaction([=] () {
                 if (root == nullptr) return;
                 deleteMin();
             });
@@ -90,7 +95,7 @@ public:
      *     and {@code null} if the key is not in the symbol table
      * @throws IllegalArgumentException if {@code key} is {@code null}
      */
-    bool innerGet(K& key, V& oldValue, const bool saveOldValue) {
+    bool innerGet(K key, V& oldValue, const bool saveOldValue) {
         bool found = get(root, key);
         if (!found) return false;
         //if (saveOldValue) oldValue = *val; // Copy of V
@@ -143,7 +148,7 @@ public:
     Node* put(Node* h, const K& key, const V& val, bool& ret) {
         if (h == nullptr) {
             ret = true;
-            return oflf::tmNew<Node>(key, val, COLOR_RED, 1);
+            return TM::template tmNew<Node>(key, val, COLOR_RED, 1);
         }
         if      (key < h->key) h->left  = put(h->left,  key, val, ret);
         else if (h->key < key) h->right = put(h->right, key, val, ret);
@@ -601,14 +606,14 @@ public:
 
     // Inserts a key only if it's not already present
     bool add(K key, const int tid=0) {
-        return oflf::updateTx<bool>([&] () {
+        return tm.template updateTransaction<bool>([=] () {
             return innerPut(key,key);
         });
     }
 
     // Returns true only if the key was present
     bool remove(K key, const int tid=0) {
-        return oflf::updateTx<bool>([&] () {
+        return tm.template updateTransaction<bool>([=] () {
             V notused;
             bool retval = innerGet(key,notused,false);
             if (retval) innerRemove(key);
@@ -617,16 +622,39 @@ public:
     }
 
     bool contains(K key, const int tid=0) {
-        return oflf::readTx<bool>([&] () {
+        return tm.template readTransaction<bool>([=] () {
             V notused;
             return innerGet(key,notused,false);
         });
     }
 
-    // This is not fully transactionally but it's ok because we use it only on initialization.
-    // We could make it fully transactionally, but we would have to increase the size of allocation/store logs.
+    // Used only on initialization. The keys are added a group at a time, not in a single transaction.
     void addAll(K** keys, int size, const int tid=0) {
-        for (int i = 0; i < size; i++) add(*keys[i], tid);
+        std::vector<K> vals(size);
+        for (int i = 0; i < size; i++) vals[i] = *keys[i];
+        tm.updateTransactionBatch(vals.data(), size, nullptr, [this] (const K& key) { return innerPut(key,key); });
+    }
+
+    // Batch versions of add(), remove() and contains(), which group several keys in each transaction
+    // (see OneFileLF::updateTransactionBatch()). If 'results' isn't nullptr, results[i] gets the result for keys[i].
+    void addAll(const K* keys, size_t size, bool* results) {
+        tm.updateTransactionBatch(keys, size, results, [this] (const K& key) { return innerPut(key,key); });
+    }
+
+    void removeAll(const K* keys, size_t size, bool* results) {
+        tm.updateTransactionBatch(keys, size, results, [this] (const K& key) {
+            V notused;
+            bool retval = innerGet(key,notused,false);
+            if (retval) innerRemove(key);
+            return retval;
+        });
+    }
+
+    void containsAll(const K* keys, size_t size, bool* results) {
+        tm.readTransactionBatch(keys, size, results, [this] (const K& key) {
+            V notused;
+            return innerGet(key,notused,false);
+        });
     }
 
     static std::string className() { return "OF-LF-RedBlackTree"; }
@@ -195,6 +195,17 @@ public:
             }
         }
 
+        // Fairness is the number of operations of the slowest thread over the fastest thread, in the worst run
+        double fairness = 1.0;
+        for (int irun = 0; irun < numRuns && !dedicated; irun++) {
+            long long minThreadOps = ops[0][irun], maxThreadOps = ops[0][irun];
+            for (int tid = 1; tid < numThreads; tid++) {
+                minThreadOps = std::min(minThreadOps, ops[tid][irun]);
+                maxThreadOps = std::max(maxThreadOps, ops[tid][irun]);
+            }
+            if (maxThreadOps != 0) fairness = std::min(fairness, (double)minThreadOps/maxThreadOps);
+        }
+
         // Compute the median. numRuns must be an odd number
         sort(agg.begin(),agg.end());
         auto maxops = agg[numRuns-1];
@@ -202,7 +213,7 @@ public:
         auto medianops = agg[numRuns/2];
         auto delta = (long)(100.*(maxops-minops) / ((double)medianops));
         // Printed value is the median of the number of ops per second that all threads were able to accomplish (on average)
-        std::cout << "Ops/sec = " << medianops << "      delta = " << delta << "%   min = " << minops << "   max = " << maxops << "\n";
+        std::cout << "Ops/sec = " << medianops << "      delta = " << delta << "%   min = " << minops << "   max = " << maxops << "   fairness = " << fairness << "\n";
         return medianops;
     }
 
@@ -312,6 +323,17 @@ public:
             }
         }
 
+        // Fairness is the number of operations of the slowest thread over the fastest thread, in the worst run
+        double fairness = 1.0;
+        for (int irun = 0; irun < numRuns && !dedicated; irun++) {
+            long long minThreadOps = ops[0][irun], maxThreadOps = ops[0][irun];
+            for (int tid = 1; tid < numThreads; tid++) {
+                minThreadOps = std::min(minThreadOps, ops[tid][irun]);
+                maxThreadOps = std::max(maxThreadOps, ops[tid][irun]);
+            }
+            if (maxThreadOps != 0) fairness = std::min(fairness, (double)minThreadOps/maxThreadOps);
+        }
+
         // Compute the median. numRuns must be an odd number
         sort(agg.begin(),agg.end());
         auto maxops = agg[numRuns-1];
@@ -319,7 +341,103 @@ public:
         auto medianops = agg[numRuns/2];
         auto delta = (long)(100.*(maxops-minops) / ((double)medianops));
         // Printed value is the median of the number of ops per second that all threads were able to accomplish (on average)
-        std::cout << "Ops/sec = " << medianops << "      delta = " << delta << "%   min = " << minops << "   max = " << maxops << "\n";
+        std::cout << "Ops/sec = " << medianops << "      delta = " << delta << "%   min = " << minops << "   max = " << maxops << "   fairness = " << fairness << "\n";
+        return medianops;
+    }
+
+    /**
+     * Same as benchmark(), but each operation is on a batch of 'batchSize' random keys, with the batch methods of the
+     * set (removeAll(), addAll() and containsAll()). The writers remove a batch of keys and then add back the ones that
+     * were removed. The result is in keys per second, to compare it among batch sizes.
+     */
+    template<typename S, typename K>
+    long long benchmarkBatch(std::string& className, const int updateRatio, const int batchSize, const seconds testLengthSeconds, const int numRuns, const int numElements) {
+        long long ops[numThreads][numRuns];
+        long long lengthSec[numRuns];
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+
+        className = S::className();
+        std::cout << "##### " << S::className() << "   batch=" << batchSize << " #####  \n";
+        S* set = new S(numThreads);
+        // Create all the keys in the concurrent set
+        K** udarray = new K*[numElements];
+        for (int i = 0; i < numElements; i++) udarray[i] = new K(i);
+        // Add all the items to the list
+        set->addAll(udarray, numElements, 0);
+
+        // Can either be a Reader or a Writer
+        auto rw_lambda = [this,&quit,&startFlag,&set,&udarray,&numElements,batchSize](const int updateRatio, long long *ops, const int tid) {
+            long long numOps = 0;
+            vector<K> keys(batchSize);
+            bool* results = new bool[batchSize];
+            while (!startFlag.load()) ; // spin
+            uint64_t seed = tid+1234567890123456781ULL;
+            while (!quit.load()) {
+                seed = randomLong(seed);
+                int update = seed%1000;
+                for (int i = 0; i < batchSize; i++) {
+                    seed = randomLong(seed);
+                    keys[i] = *udarray[seed%numElements];
+                }
+                if (update < updateRatio) {
+                    // I'm a Writer
+                    set->removeAll(keys.data(), batchSize, results);
+                    int numRemoved = 0;
+                    for (int i = 0; i < batchSize; i++) {
+                        if (results[i]) keys[numRemoved++] = keys[i];
+                    }
+                    set->addAll(keys.data(), numRemoved, results);
+                    numOps += batchSize + numRemoved;
+                } else {
+                    // I'm a Reader
+                    set->containsAll(keys.data(), batchSize, results);
+                    numOps += batchSize;
+                }
+            }
+            delete[] results;
+            *ops = numOps;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            thread rwThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) rwThreads[tid] = thread(rw_lambda, updateRatio, &ops[tid][irun], tid);
+            this_thread::sleep_for(100ms);
+            auto startBeats = steady_clock::now();
+            startFlag.store(true);
+            // Sleep for testLengthSeconds seconds
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            auto stopBeats = steady_clock::now();
+            for (int tid = 0; tid < numThreads; tid++) rwThreads[tid].join();
+            lengthSec[irun] = (stopBeats-startBeats).count();
+            quit.store(false);
+            startFlag.store(false);
+        }
+
+        // Clear the set, one key at a time and then delete the instance
+        for (int i = 0; i < numElements; i++) set->remove(*udarray[i], 0);
+        delete set;
+
+        for (int i = 0; i < numElements; i++) delete udarray[i];
+        delete[] udarray;
+
+        // Accounting
+        vector<long long> agg(numRuns);
+        for (int irun = 0; irun < numRuns; irun++) {
+            for (int tid = 0; tid < numThreads; tid++) {
+                agg[irun] += ops[tid][irun]*1000000000LL/lengthSec[irun];
+            }
+        }
+
+        // Compute the median. numRuns must be an odd number
+        sort(agg.begin(),agg.end());
+        auto maxops = agg[numRuns-1];
+        auto minops = agg[0];
+        auto medianops = agg[numRuns/2];
+        auto delta = (long)(100.*(maxops-minops) / ((double)medianops));
+        // Printed value is the median of the number of keys per second that all threads were able to process (on average)
+        std::cout << "Keys/sec = " << medianops << "      delta = " << delta << "%   min = " << minops << "   max = " << maxops << "\n";
         return medianops;
     }
 
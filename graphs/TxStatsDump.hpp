@@ -0,0 +1,47 @@
+/*
+ * Copyright 2017-2018
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Nachshon Cohen <nachshonc@gmail.com>
+ *
+ * This work is published under the MIT license. See LICENSE.txt
+ */
+#ifndef _TX_STATS_DUMP_H_
+#define _TX_STATS_DUMP_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+/**
+ * Prints the transaction statistics (TxStats) of one of the OneFile STMs or PTMs.
+ * They are collected only when the benchmark is compiled with -DTX_STATS_ENABLED, otherwise this prints nothing.
+ * To get the statistics of a single benchmark, pass the difference between the snapshots taken before and after it:
+ *
+ *   auto before = oflf::gOFLF.getTxStats();
+ *   results[ic][it][ir] = bench.benchmark<OFLFLinkedListSet<UserData>,UserData>(cNames[ic], ...);
+ *   dumpTxStats(cNames[ic], oflf::gOFLF.getTxStats() - before);
+ */
+template<typename S> void dumpTxStats(const std::string& className, const S& st) {
+    if (!S::enabled) return;
+    const uint64_t aborts = st.abortsLoad + st.abortsCommit + st.abortsBegin;
+    const double commits = (st.commits == 0) ? 1.0 : (double)st.commits;
+    std::cout << "TxStats " << className << ":  commits=" << st.commits << "  aborts=" << aborts;
+    std::cout << " (load=" << st.abortsLoad << " commit=" << st.abortsCommit << " begin=" << st.abortsBegin << ")";
+    std::cout << "  helps=" << st.helps << "  helpBytes=" << st.helpBytes;
+    std::cout << "  allocs/tx=" << st.allocs/commits << "  retires/tx=" << st.retires/commits;
+    std::cout << "  retiredList=" << st.retiredListLength << "\n";
+    std::cout << "  write-set sizes:";
+    for (int i = 0; i < S::WS_BUCKETS; i++) {
+        if (st.wsHistogram[i] == 0) continue;
+        const uint64_t low = (i == 0) ? 0 : 1ULL << (i-1);
+        std::cout << "  " << low;
+        if (i == S::WS_BUCKETS-1) std::cout << "+";
+        else if (i > 1) std::cout << "-" << (1ULL << i)-1;
+        std::cout << "=" << st.wsHistogram[i];
+    }
+    std::cout << "\n";
+}
+
+#endif /* _TX_STATS_DUMP_H_ */
@@ -0,0 +1,96 @@
+/*
+ * Microbenchmark for WriteSet::apply() of OneFileLF, single-threaded.
+ * Measures the time to apply each entry of a write-set (in nanoseconds) for:
+ * - random write-sets: each entry modifies a word in a different node;
+ * - clustered write-sets: each node has all its words modified, but the entries are shuffled in the log,
+ *   like what happens in a tree rebalancing or in a hash table rebuild;
+ * and for each of these, without prefetching, with prefetching (TX_PREFETCH_DISTANCE), and with prefetching
+ * plus sorting the log by address (TX_APPLY_SORTED).
+ */
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "stms/OneFileLF.hpp"
+
+#define DATA_FILENAME "data/apply-writeset.txt"
+
+using namespace std;
+using namespace chrono;
+
+// A node that takes one cache line: 16 bytes of tmbase plus 3 words of 16 bytes
+struct alignas(64) Node : public oflf::tmbase {
+    static const int NUM_WORDS = 3;
+    oflf::tmtype<uint64_t> words[NUM_WORDS];
+};
+
+static const uint64_t numNodes = 4*1024*1024;  // 256 MB, much larger than the last level cache
+
+int main(void) {
+    const std::string dataFilename {DATA_FILENAME};
+    vector<uint64_t> storesList = { 64, 256, 1024, 4096, 16384, 65536 };  // Number of entries in the write-set
+    const int numRuns = 50;                                                  // Write-sets applied per data point
+    const int NUM_CLASSES = 6;
+    const std::string cNames[NUM_CLASSES] = { "Random", "Random-Prefetch", "Random-Prefetch-Sorted",
+                                              "Clustered", "Clustered-Prefetch", "Clustered-Prefetch-Sorted" };
+    double results[NUM_CLASSES][storesList.size()];
+
+    std::cout << "\n----- WriteSet::apply() microbenchmark (ns per entry)   numNodes=" << numNodes << "   runs=" << numRuns << " -----\n";
+    Node* nodes = new Node[numNodes];
+    oflf::WriteSet* ws = new oflf::WriteSet();
+    std::mt19937_64 rng {42};
+    uint64_t seq = 1;
+    for (int is = 0; is < storesList.size(); is++) {
+        const uint64_t numStores = storesList[is];
+        for (int ic = 0; ic < NUM_CLASSES; ic++) {
+            const bool clustered = (ic >= 3);
+            const uint64_t prefetchDistance = (ic % 3 == 0) ? 0 : oflf::TX_PREFETCH_DISTANCE;
+            const bool sorted = (ic % 3 == 2);
+            uint64_t totalNanos = 0;
+            for (int irun = 0; irun < numRuns; irun++) {
+                // Fill the write-set, outside of the measurement
+                vector<void*> addrs;
+                if (clustered) {
+                    while (addrs.size() < numStores) {
+                        Node* node = &nodes[rng() % numNodes];
+                        for (int w = 0; w < Node::NUM_WORDS; w++) addrs.push_back(&node->words[w]);
+                    }
+                } else {
+                    for (uint64_t i = 0; i < numStores; i++) addrs.push_back(&nodes[rng() % numNodes].words[rng() % Node::NUM_WORDS]);
+                }
+                std::shuffle(addrs.begin(), addrs.end(), rng);
+                ws->numStores = 0;
+                for (void* addr : addrs) ws->addOrReplace(addr, seq);
+                seq++;
+                auto startBeats = steady_clock::now();
+                if (sorted) ws->sortByAddress();
+                ws->apply(seq, 0, prefetchDistance);
+                auto stopBeats = steady_clock::now();
+                totalNanos += duration_cast<nanoseconds>(stopBeats-startBeats).count();
+            }
+            results[ic][is] = (double)totalNanos/(numRuns*ws->numStores);
+            std::cout << "stores=" << numStores << "\t" << cNames[ic] << "\t" << results[ic][is] << " ns/entry\n";
+        }
+    }
+    delete ws;
+    delete[] nodes;
+
+    // Export tab-separated values to a file to be imported in gnuplot or excel
+    ofstream dataFile;
+    dataFile.open(dataFilename);
+    dataFile << "Stores\t";
+    for (int ic = 0; ic < NUM_CLASSES; ic++) dataFile << cNames[ic] << "\t";
+    dataFile << "\n";
+    for (int is = 0; is < storesList.size(); is++) {
+        dataFile << storesList[is] << "\t";
+        for (int ic = 0; ic < NUM_CLASSES; ic++) dataFile << results[ic][is] << "\t";
+        dataFile << "\n";
+    }
+    dataFile.close();
+    std::cout << "\nSuccessfuly saved results in " << dataFilename << "\n";
+
+    return 0;
+}
@@ -36,8 +36,20 @@ int main(void) {
 #else
         results[ic][it] = bench.latencyBenchmark<oflf::OneFileLF,oflf::tmtype>(cNames[ic]);
         ic++;
+        // Same as above, in the hybrid mode, which switches to announce-and-help after TX_HYBRID_ABORTS aborts
+        oflf::gOFLF.setHybrid(true);
+        results[ic][it] = bench.latencyBenchmark<oflf::OneFileLF,oflf::tmtype>(cNames[ic]);
+        ic++;
+        oflf::gOFLF.setHybrid(oflf::TX_HYBRID);
         results[ic][it] = bench.latencyBenchmark<ofwf::OneFileWF,ofwf::tmtype>(cNames[ic]);
         ic++;
+        // Same as above, with each commit executing at most 1 and 4 of the announced transactions of other threads
+        for (uint64_t maxOps : { 1, 4 }) {
+            ofwf::gOFWF.setHelpingLimits(maxOps);
+            results[ic][it] = bench.latencyBenchmark<ofwf::OneFileWF,ofwf::tmtype>(cNames[ic]);
+            ic++;
+        }
+        ofwf::gOFWF.setHelpingLimits(ofwf::TX_HELP_MAX_OPS, ofwf::TX_HELP_MAX_STORES);
         results[ic][it] = bench.latencyBenchmark<estm::ESTM,estm::tmtype>(cNames[ic]);
         ic++;
 #endif
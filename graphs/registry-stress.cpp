@@ -0,0 +1,37 @@
+/*
+ * Stress test of ThreadRegistryBitmap: threads acquire and release tids in a loop while tid 0 stays taken, and each
+ * one checks that getMaxThreads() covers the tid it holds. A tid above getMaxThreads() would be skipped by the scans
+ * of Hazard Eras, of the helping in OneFile, and of the readers in RomulusLR.
+ * Usage: registry-stress [iterations per thread] [threads]. Returns 1 if it finds an uncovered tid.
+ */
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include "common/ThreadRegistryBitmap.hpp"
+
+int main(int argc, char* argv[]) {
+    const int numThreads = (argc > 2) ? std::atoi(argv[2]) : 8;
+    const long numIters = (argc > 1) ? std::atol(argv[1]) : 20000000;
+    ThreadRegistryBitmap<128> tids;
+    const int heldTid = tids.acquire();   // Stays taken until the end
+    std::atomic<long> failures {0};
+    std::vector<std::thread> threads;
+    for (int it = 0; it < numThreads; it++) {
+        threads.push_back(std::thread([&] () {
+            for (long i = 0; i < numIters; i++) {
+                const int tid = tids.acquire();
+                for (int j = 0; j < 4; j++) {
+                    if ((uint64_t)tid >= tids.getMaxThreads()) failures.fetch_add(1);
+                }
+                tids.release(tid);
+            }
+        }));
+    }
+    for (auto& t : threads) t.join();
+    if ((uint64_t)heldTid >= tids.getMaxThreads()) failures.fetch_add(1);
+    std::cout << "registry-stress: " << numThreads << " threads x " << numIters << " acquire/release, ";
+    std::cout << failures.load() << " times a tid was not covered by getMaxThreads()\n";
+    return failures.load() == 0 ? 0 : 1;
+}
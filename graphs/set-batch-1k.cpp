@@ -0,0 +1,74 @@
+/*
+ * Throughput of the batch operations (addAll(), removeAll() and containsAll()) of the OneFile sets, in keys per
+ * second, for several batch sizes. A batch size of 1 gives one transaction per key, like the other set benchmarks.
+ */
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include "BenchmarkSets.hpp"
+#include "datastructures/hashmaps/OFLFResizableHashSet.hpp"
+#include "datastructures/hashmaps/OFWFResizableHashSet.hpp"
+#include "datastructures/treemaps/OFLFRedBlackTree.hpp"
+#include "datastructures/treemaps/OFWFRedBlackTree.hpp"
+
+#define DATA_FILENAME "data/set-batch-1k.txt"
+
+
+int main(void) {
+    const std::string dataFilename {DATA_FILENAME};
+    vector<int> threadList = { 1, 2, 4, 8, 16, 32, 48, 64 };     // For the laptop or AWS c5.9xlarge
+    vector<int> ratioList = { 1000, 100, 0 };                    // Permil ratio: 100%, 10%, 0%
+    vector<int> batchList = { 1, 8, 64, 256 };                   // Number of keys in each call to the set
+    const int numElements = 1000;                                // Number of keys in the set
+    const int numRuns = 1;
+    const seconds testLength = 20s;
+    const int NUM_CLASSES = 4;
+    uint64_t results[NUM_CLASSES][batchList.size()][threadList.size()][ratioList.size()];
+    std::string cNames[NUM_CLASSES];
+    // Reset results
+    std::memset(results, 0, sizeof(uint64_t)*NUM_CLASSES*batchList.size()*threadList.size()*ratioList.size());
+
+    double totalHours = (double)NUM_CLASSES*batchList.size()*ratioList.size()*threadList.size()*testLength.count()*numRuns/(60.*60.);
+    std::cout << "This benchmark is going to take at most " << totalHours << " hours to complete\n";
+
+    for (unsigned ir = 0; ir < ratioList.size(); ir++) {
+        auto ratio = ratioList[ir];
+        for (unsigned it = 0; it < threadList.size(); it++) {
+            auto nThreads = threadList[it];
+            BenchmarkSets bench(nThreads);
+            for (unsigned ib = 0; ib < batchList.size(); ib++) {
+                auto batch = batchList[ib];
+                std::cout << "\n----- Sets (Batch)   numElements=" << numElements << "   ratio=" << ratio/10. << "%   threads=" << nThreads << "   batch=" << batch << "   runs=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+                results[0][ib][it][ir] = bench.benchmarkBatch<OFLFResizableHashSet<uint64_t>,uint64_t>(cNames[0], ratio, batch, testLength, numRuns, numElements);
+                results[1][ib][it][ir] = bench.benchmarkBatch<OFWFResizableHashSet<uint64_t>,uint64_t>(cNames[1], ratio, batch, testLength, numRuns, numElements);
+                results[2][ib][it][ir] = bench.benchmarkBatch<OFLFRedBlackTree<uint64_t,uint64_t>,uint64_t>(cNames[2], ratio, batch, testLength, numRuns, numElements);
+                results[3][ib][it][ir] = bench.benchmarkBatch<OFWFRedBlackTree<uint64_t,uint64_t>,uint64_t>(cNames[3], ratio, batch, testLength, numRuns, numElements);
+            }
+        }
+    }
+
+    // Export tab-separated values to a file to be imported in gnuplot or excel
+    ofstream dataFile;
+    dataFile.open(dataFilename);
+    dataFile << "Threads\t";
+    // Printf class names, ratios and batch sizes for each column
+    for (unsigned ir = 0; ir < ratioList.size(); ir++) {
+        for (int ic = 0; ic < NUM_CLASSES; ic++) {
+            for (unsigned ib = 0; ib < batchList.size(); ib++) dataFile << cNames[ic] << "-" << ratioList[ir]/10. << "%-B" << batchList[ib] << "\t";
+        }
+    }
+    dataFile << "\n";
+    for (unsigned it = 0; it < threadList.size(); it++) {
+        dataFile << threadList[it] << "\t";
+        for (unsigned ir = 0; ir < ratioList.size(); ir++) {
+            for (int ic = 0; ic < NUM_CLASSES; ic++) {
+                for (unsigned ib = 0; ib < batchList.size(); ib++) dataFile << results[ic][ib][it][ir] << "\t";
+            }
+        }
+        dataFile << "\n";
+    }
+    dataFile.close();
+    std::cout << "\nSuccessfuly saved results in " << dataFilename << "\n";
+
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include "datastructures/linkedlists/MagedHarrisLinkedListSetHE.hpp"
 #include "datastructures/linkedlists/OFLFLinkedListSet.hpp"
 #include "datastructures/linkedlists/OFWFLinkedListSet.hpp"
+#include "TxStatsDump.hpp"
 // Macros suck, but it's either TL2 or TinySTM or ESTM, we can't have all at the same time
 #if defined USE_TL2
 #include "datastructures/linkedlists/TL2STMLinkedListSet.hpp"
@@ -32,6 +33,11 @@ int main(void) {
     int maxClass = 0;
     // Reset results
     std::memset(results, 0, sizeof(uint64_t)*EMAX_CLASS*threadList.size()*ratioList.size());
+    // Print the transaction statistics of the last OneFile benchmark (only when compiled with -DTX_STATS_ENABLED)
+    auto lfStats = oflf::gOFLF.getTxStats();
+    auto wfStats = ofwf::gOFWF.getTxStats();
+    auto dumpLF = [&] (const std::string& name) { auto st = oflf::gOFLF.getTxStats(); dumpTxStats(name, st - lfStats); lfStats = st; };
+    auto dumpWF = [&] (const std::string& name) { auto st = ofwf::gOFWF.getTxStats(); dumpTxStats(name, st - wfStats); wfStats = st; };
 
     double totalHours = (double)EMAX_CLASS*ratioList.size()*threadList.size()*testLength.count()*numRuns/(60.*60.);
     std::cout << "This benchmark is going to take at most " << totalHours << " hours to complete\n";
@@ -51,8 +57,20 @@ int main(void) {
             ic++;
 #else
             results[ic][it][ir] = bench.benchmark<OFLFLinkedListSet<UserData>,UserData>              (cNames[ic], ratio, testLength, numRuns, numElements, false);
+            dumpLF(cNames[ic]);
             ic++;
+            // Same as above, with the other contention management policies of OneFileLF
+            oflf::gOFLF.setContentionPolicy(oflf::CM_BACKOFF);
+            results[ic][it][ir] = bench.benchmark<OFLFLinkedListSet<UserData>,UserData>              (cNames[ic], ratio, testLength, numRuns, numElements, false);
+            dumpLF(cNames[ic]);
+            ic++;
+            oflf::gOFLF.setContentionPolicy(oflf::CM_KARMA);
+            results[ic][it][ir] = bench.benchmark<OFLFLinkedListSet<UserData>,UserData>              (cNames[ic], ratio, testLength, numRuns, numElements, false);
+            dumpLF(cNames[ic]);
+            ic++;
+            oflf::gOFLF.setContentionPolicy(oflf::TX_CONTENTION);
             results[ic][it][ir] = bench.benchmark<OFWFLinkedListSet<UserData>,UserData>              (cNames[ic], ratio, testLength, numRuns, numElements, false);
+            dumpWF(cNames[ic]);
             ic++;
             results[ic][it][ir] = bench.benchmark<ESTMLinkedListSet<UserData>,UserData>              (cNames[ic], ratio, testLength, numRuns, numElements, false);
             ic++;
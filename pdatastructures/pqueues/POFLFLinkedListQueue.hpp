@@ -26,26 +26,29 @@
  * enqueue min ops: 2 DCAS + 1 CAS
  * dequeue min ops: 1 DCAS + 1 CAS
  */
-template<typename T>
+template<typename T, typename Config=poflf::DefaultConfig>
 class POFLFLinkedListQueue : public poflf::tmbase {
 
 private:
+    typedef poflf::Engine<Config> TM;   // The engine with the configuration 'Config' (see poflf::DefaultConfig)
+    template<typename X> using tmtype = typename TM::template tmtype<X>;
+
     struct Node : poflf::tmbase {
-        poflf::tmtype<T> item;
-        poflf::tmtype<Node*> next {nullptr};
+        tmtype<T> item;
+        tmtype<Node*> next {nullptr};
         Node(T userItem) : item{userItem} { }
     };
 
-    poflf::tmtype<Node*>  head {nullptr};
-    poflf::tmtype<Node*>  tail {nullptr};
+    tmtype<Node*>  head {nullptr};
+    tmtype<Node*>  tail {nullptr};
 
 
 public:
     T EMPTY {};
 
     POFLFLinkedListQueue(unsigned int maxThreads=0) {
-        poflf::updateTx([=] () {
-            Node* sentinelNode = poflf::tmNew<Node>(EMPTY);
+        TM::updateTx([=] () {
+            Node* sentinelNode = TM::template tmNew<Node>(EMPTY);
             head = sentinelNode;
             tail = sentinelNode;
         });
@@ -53,10 +56,10 @@ public:
 
 
     ~POFLFLinkedListQueue() {
-        poflf::updateTx([=] () {
+        TM::updateTx([=] () {
             while (dequeue() != EMPTY); // Drain the queue
             Node* lhead = head;
-            poflf::tmDelete(lhead);
+            TM::tmDelete(lhead);
         });
     }
 
@@ -70,8 +73,8 @@ public:
      */
     bool enqueue(T item, const int tid=0) {
         if (item == EMPTY) throw std::invalid_argument("item can not be nullptr");
-        return poflf::updateTx<bool>([this,item] () -> bool {
-            Node* newNode = poflf::tmNew<Node>(item);
+        return TM::template updateTx<bool>([this,item] () -> bool {
+            Node* newNode = TM::template tmNew<Node>(item);
             tail->next = newNode;
             tail = newNode;
             return true;
@@ -83,11 +86,11 @@ public:
      * Progress Condition: lock-free
      */
     T dequeue(const int tid=0) {
-        return poflf::updateTx<T>([this] () -> T {
+        return TM::template updateTx<T>([this] () -> T {
             Node* lhead = head;
             if (lhead == tail) return EMPTY;
             head = lhead->next;
-            poflf::tmDelete(lhead);
+            TM::tmDelete(lhead);
             return head->item;
         });
     }
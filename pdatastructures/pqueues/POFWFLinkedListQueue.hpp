@@ -25,26 +25,29 @@
  * enqueue min ops: 2 DCAS + 1 CAS
  * dequeue min ops: 1 DCAS + 1 CAS
  */
-template<typename T>
+template<typename T, typename Config=pofwf::DefaultConfig>
 class POFWFLinkedListQueue : public pofwf::tmbase {
 
 private:
+    typedef pofwf::Engine<Config> TM;   // The engine with the configuration 'Config' (see pofwf::DefaultConfig)
+    template<typename X> using tmtype = typename TM::template tmtype<X>;
+
     struct Node : pofwf::tmbase {
-        pofwf::tmtype<T> item;
-        pofwf::tmtype<Node*> next {nullptr};
+        tmtype<T> item;
+        tmtype<Node*> next {nullptr};
         Node(T userItem) : item{userItem} { }
     };
 
-    pofwf::tmtype<Node*>  head {nullptr};
-    pofwf::tmtype<Node*>  tail {nullptr};
+    tmtype<Node*>  head {nullptr};
+    tmtype<Node*>  tail {nullptr};
 
 
 public:
     T EMPTY {};
 
     POFWFLinkedListQueue(unsigned int maxThreads=0) {
-        pofwf::updateTx([=] () {
-            Node* sentinelNode = pofwf::tmNew<Node>(EMPTY);
+        TM::updateTx([=] () {
+            Node* sentinelNode = TM::template tmNew<Node>(EMPTY);
             head = sentinelNode;
             tail = sentinelNode;
         });
@@ -52,10 +55,10 @@ public:
 
 
     ~POFWFLinkedListQueue() {
-        pofwf::updateTx([=] () {
+        TM::updateTx([=] () {
             while (dequeue() != EMPTY); // Drain the queue
             Node* lhead = head;
-            pofwf::tmDelete(lhead);
+            TM::tmDelete(lhead);
         });
     }
 
@@ -69,8 +72,8 @@ public:
      */
     bool enqueue(T item, const int tid=0) {
         if (item == EMPTY) throw std::invalid_argument("item can not be nullptr");
-        return pofwf::updateTx<bool>([this,item] () -> bool {
-            Node* newNode = pofwf::tmNew<Node>(item);
+        return TM::template updateTx<bool>([this,item] () -> bool {
+            Node* newNode = TM::template tmNew<Node>(item);
             tail->next = newNode;
             tail = newNode;
             return true;
@@ -82,11 +85,11 @@ public:
      * Progress Condition: wait-free
      */
     T dequeue(const int tid=0) {
-        return pofwf::updateTx<T>([this] () -> T {
+        return TM::template updateTx<T>([this] () -> T {
             Node* lhead = head;
             if (lhead == tail) return EMPTY;
             head = lhead->next;
-            pofwf::tmDelete(lhead);
+            TM::tmDelete(lhead);
             return head->item;
         });
     }
@@ -16,11 +16,14 @@
 #include <vector>
 #include <functional>
 #include <cstring>
+#include <algorithm>   // Needed by std::sort
+#include <immintrin.h>  // Needed by the SIMD probing of the WriteSet index
 #include <sys/mman.h>   // Needed if we use mmap()
 #include <sys/types.h>  // Needed by open() and close()
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>     // Needed by close()
+#include "../common/ThreadRegistryBitmap.hpp"
 
 // Please keep this file in sync (as much as possible) with stms/OneFileLF.hpp
 
@@ -60,29 +63,55 @@
  * - The set of the request in helpApply() is always done with a CAS to enforce ordering on the PWBs of the DCAS;
  * - The persistent logs are allocated in PM, same as all user allocations from tmNew(), 'curTx', and 'request'
  */
+// The engine is defined in an inline namespace named after the capacity of the registry, which changes DefaultConfig
+// (see below). Translation units compiled with different values of REGISTRY_CAPACITY then don't share incompatible
+// definitions under the same names, and mixing them fails to link instead of silently breaking the One Definition Rule.
+#define POFLF_NS_CAT_(a,b) a##b
+#define POFLF_NS_CAT(a,b) POFLF_NS_CAT_(a,b)
+#ifdef REGISTRY_CAPACITY
+#define POFLF_CONFIG_NS POFLF_NS_CAT(cfg_default_, REGISTRY_CAPACITY)
+#else
+#define POFLF_CONFIG_NS cfg_default
+#endif
+
 namespace poflf {
+inline namespace POFLF_CONFIG_NS {
 
 //
 // User configurable variables.
 // Feel free to change these if you need larger transactions, more allocations per transacation, or more threads.
 //
 
-// Maximum number of registered threads that can execute transactions
-static const int REGISTRY_MAX_THREADS = 128;
-// Maximum number of stores in the WriteSet per transaction
-static const uint64_t TX_MAX_STORES = 40*1024;
-// Number of buckets in the hashmap of the WriteSet.
-static const uint64_t HASH_BUCKETS = 2048;
-
-// Persistent-specific configuration
-// Name of persistent file mapping
-static const char * PFILE_NAME = "/dev/shm/ponefilelf_shared";
-// Start address of mapped persistent memory
-static uint8_t* PREGION_ADDR = (uint8_t*)0x7fea00000000;
-// Size of persistent memory. Part of it will be used by the redo logs
-static const uint64_t PREGION_SIZE = 1024*1024*1024ULL;   // 1 GB by default
-// End address of mapped persistent memory
-static uint8_t* PREGION_END = (PREGION_ADDR+PREGION_SIZE);
+// Configuration policy with the capacities and the persistent region of the engine, which Engine<Config> takes its
+// constants from (see them for what each member means). To size the engine for a particular workload, declare a struct
+// with the same members and use it as the Config of Engine and of the data structures. Engines with different
+// configurations are independent from each other, and can be used in the same program if their regions don't overlap.
+struct DefaultConfig {
+#ifdef REGISTRY_CAPACITY
+    static constexpr int      registryThreads = REGISTRY_CAPACITY;
+#else
+    static constexpr int      registryThreads = 128;
+#endif
+    static constexpr uint64_t maxStores = 40*1024;
+    static constexpr uint64_t indexSlots = 64;
+    static constexpr uint64_t linearStores = 0;
+    static constexpr const char* fileName = "/dev/shm/ponefilelf_shared";
+    static constexpr uint64_t regionAddr = 0x7fea00000000;
+    static constexpr uint64_t regionSize = 1024*1024*1024ULL;   // 1 GB by default
+};
+// Number of entries ahead of the current one that WriteSet::apply() prefetches (for write). Zero disables prefetching.
+static const uint64_t TX_PREFETCH_DISTANCE = 8;
+// If true, the WriteSet is sorted by address before being published, so that apply() touches the words of a node one
+// after the other, instead of in the order they were stored.
+static const bool TX_APPLY_SORTED = false;
+// Per-thread transaction statistics (see TxStats). Compile with -DTX_STATS_ENABLED to collect them, otherwise the
+// counters are compiled out and cost nothing.
+#ifdef TX_STATS_ENABLED
+static const bool TX_STATS = true;
+#else
+static const bool TX_STATS = false;
+#endif
+
 // Maximum number of root pointers available for the user
 static const uint64_t MAX_ROOT_POINTERS = 100;
 
@@ -103,17 +132,6 @@ static const uint64_t MAX_ROOT_POINTERS = 100;
     __ret; })
 
 
-// Functions to convert between a transaction identifier (uint64_t) and a pair of {sequence,index}
-static inline uint64_t seqidx2trans(uint64_t seq, uint64_t idx) {
-    return (seq << 10) | idx;
-}
-static inline uint64_t trans2seq(uint64_t trans) {
-    return trans >> 10;
-}
-static inline uint64_t trans2idx(uint64_t trans) {
-    return trans & 0x3FF; // 10 bits
-}
-
 // Flush each cache line in a range
 static inline void flushFromTo(void* from, void* to) noexcept {
     const uint64_t cache_line_size = 64;
@@ -122,89 +140,6 @@ static inline void flushFromTo(void* from, void* to) noexcept {
 }
 
 
-//
-// Thread Registry stuff
-//
-extern void thread_registry_deregister_thread(const int tid);
-
-// An helper class to do the checkin and checkout of the thread registry
-struct ThreadCheckInCheckOut {
-    static const int NOT_ASSIGNED = -1;
-    int tid { NOT_ASSIGNED };
-    ~ThreadCheckInCheckOut() {
-        if (tid == NOT_ASSIGNED) return;
-        thread_registry_deregister_thread(tid);
-    }
-};
-
-extern thread_local ThreadCheckInCheckOut tl_tcico;
-
-// Forward declaration of global/singleton instance
-class ThreadRegistry;
-extern ThreadRegistry gThreadRegistry;
-
-/*
- * <h1> Registry for threads </h1>
- *
- * This is singleton type class that allows assignement of a unique id to each thread.
- * The first time a thread calls ThreadRegistry::getTID() it will allocate a free slot in 'usedTID[]'.
- * This tid wil be saved in a thread-local variable of the type ThreadCheckInCheckOut which
- * upon destruction of the thread will call the destructor of ThreadCheckInCheckOut and free the
- * corresponding slot to be used by a later thread.
- */
-class ThreadRegistry {
-private:
-    alignas(128) std::atomic<bool>      usedTID[REGISTRY_MAX_THREADS];   // Which TIDs are in use by threads
-    alignas(128) std::atomic<int>       maxTid {-1};                     // Highest TID (+1) in use by threads
-
-public:
-    ThreadRegistry() {
-        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
-            usedTID[it].store(false, std::memory_order_relaxed);
-        }
-    }
-
-    // Progress condition: wait-free bounded (by the number of threads)
-    int register_thread_new(void) {
-        for (int tid = 0; tid < REGISTRY_MAX_THREADS; tid++) {
-            if (usedTID[tid].load(std::memory_order_acquire)) continue;
-            bool unused = false;
-            if (!usedTID[tid].compare_exchange_strong(unused, true)) continue;
-            // Increase the current maximum to cover our thread id
-            int curMax = maxTid.load();
-            while (curMax <= tid) {
-                maxTid.compare_exchange_strong(curMax, tid+1);
-                curMax = maxTid.load();
-            }
-            tl_tcico.tid = tid;
-            return tid;
-        }
-        std::cout << "ERROR: Too many threads, registry can only hold " << REGISTRY_MAX_THREADS << " threads\n";
-        assert(false);
-    }
-
-    // Progress condition: wait-free population oblivious
-    inline void deregister_thread(const int tid) {
-        usedTID[tid].store(false, std::memory_order_release);
-    }
-
-    // Progress condition: wait-free population oblivious
-    static inline uint64_t getMaxThreads(void) {
-        return gThreadRegistry.maxTid.load(std::memory_order_acquire);
-    }
-
-    // Progress condition: wait-free bounded (by the number of threads)
-    static inline int getTID(void) {
-        int tid = tl_tcico.tid;
-        if (tid != ThreadCheckInCheckOut::NOT_ASSIGNED) return tid;
-        return gThreadRegistry.register_thread_new();
-    }
-};
-
-
-// Forward declaration needed by EsLoco
-template<typename T> struct tmtype;
-
 // We need to split the contents from the methods due to compilation dependencies
 template<typename T> struct tmtypebase {
     // Stores the actual value as an atomic
@@ -357,555 +292,1121 @@ struct PWriteSetEntry {
 };
 
 
-// The persistent write-set (undo log)
-struct PWriteSet {
-    uint64_t              numStores {0};          // Number of stores in the writeSet for the current transaction
-    std::atomic<uint64_t> request {0};            // Can be moved to CLOSED by other threads, using a CAS
-    PWriteSetEntry        plog[TX_MAX_STORES];    // Redo log of stores
+// A single entry in the write-set
+struct WriteSetEntry {
+    void*          addr {nullptr};  // Address of value+sequence to change
+    uint64_t       val;             // Desired value to change to
+};
 
-    // Applies all entries in the log. Called only by recover() which is non-concurrent.
-    void applyFromRecover() {
-        // We're assuming that 'val' is the size of a uint64_t
-        for (uint64_t i = 0; i < numStores; i++) {
-            *((uint64_t*)plog[i].addr) = plog[i].val;
-            PWB(plog[i].addr);
-        }
+// Transaction statistics, summed over all threads by getTxStats(). They are collected only when TX_STATS is
+// true, otherwise all the counters are zero. Subtract two snapshots to get the statistics of an interval.
+struct TxStats {
+    static const bool enabled = TX_STATS;
+    static const int  WS_BUCKETS = 16;    // Bucket i>0 of wsHistogram counts write-sets of 2^(i-1) to 2^i-1 stores
+    uint64_t commits {0};                 // Committed transactions, including read-only ones
+    uint64_t abortsLoad {0};              // Aborts because a load saw a sequence newer than the transaction
+    uint64_t abortsCommit {0};            // Aborts because curTx changed before the commit, or the CAS on curTx failed
+    uint64_t abortsBegin {0};             // Restarts of a transaction because curTx changed while it was starting
+    uint64_t helps {0};                   // Calls to helpApply() that applied the write-set of another thread
+    uint64_t helpBytes {0};               // Bytes of write-set entries copied from other threads by helpApply()
+    uint64_t allocs {0};                  // Allocations done by transactions, including the ones that aborted
+    uint64_t retires {0};                 // Objects freed by transactions, including the ones that aborted
+    uint64_t wsHistogram[WS_BUCKETS] {};  // Committed transactions for each size of the write-set
+    uint64_t retiredListLength {0};       // Always zero, there is no Hazard Eras in this PTM
+
+    TxStats operator-(const TxStats& other) const {
+        TxStats st {*this};
+        st.commits -= other.commits;
+        st.abortsLoad -= other.abortsLoad;
+        st.abortsCommit -= other.abortsCommit;
+        st.abortsBegin -= other.abortsBegin;
+        st.helps -= other.helps;
+        st.helpBytes -= other.helpBytes;
+        st.allocs -= other.allocs;
+        st.retires -= other.retires;
+        for (int i = 0; i < WS_BUCKETS; i++) st.wsHistogram[i] -= other.wsHistogram[i];
+        return st;
     }
 };
 
 
-// The persistent metadata is a 'header' that contains all the logs and the persistent curTx variable.
-// It is located at the start of the persistent region, and the remaining region contains the data available for the allocator to use.
-struct PMetadata {
-    static const uint64_t   MAGIC_ID = 0x1337babe;
-    std::atomic<uint64_t>   curTx {seqidx2trans(1,0)};
-    std::atomic<uint64_t>   pad1[15];
-    tmtypebase<void*>       rootPtrs[MAX_ROOT_POINTERS];
-    PWriteSet               plog[REGISTRY_MAX_THREADS];
-    uint64_t                id {0};
-    uint64_t                pad2 {0};
+// Counters of the TxStats of one thread, written only by the owner thread.
+// TxCounters<false> is empty and all its methods do nothing, which is how the statistics are compiled out.
+template<bool enabled> struct TxCounters {
+    std::atomic<uint64_t> commits {0};
+    std::atomic<uint64_t> abortsLoad {0};
+    std::atomic<uint64_t> abortsCommit {0};
+    std::atomic<uint64_t> abortsBegin {0};
+    std::atomic<uint64_t> helps {0};
+    std::atomic<uint64_t> helpBytes {0};
+    std::atomic<uint64_t> allocs {0};
+    std::atomic<uint64_t> retires {0};
+    std::atomic<uint64_t> wsHistogram[TxStats::WS_BUCKETS] {};
+
+    static inline void inc(std::atomic<uint64_t>& counter, uint64_t n=1) {
+        counter.store(counter.load(std::memory_order_relaxed)+n, std::memory_order_relaxed);
+    }
+    inline void onCommit(uint64_t numStores, uint64_t numAllocs, uint64_t numRetires) {
+        inc(commits);
+        inc(allocs, numAllocs);
+        inc(retires, numRetires);
+        inc(wsHistogram[numStores == 0 ? 0 : std::min(64-__builtin_clzll(numStores), TxStats::WS_BUCKETS-1)]);
+    }
+    inline void onAbortLoad() { inc(abortsLoad); }
+    inline void onAbortCommit() { inc(abortsCommit); }
+    inline void onAbortBegin() { inc(abortsBegin); }
+    inline void onHelp(uint64_t bytes) { inc(helps); inc(helpBytes, bytes); }
+    inline void onAlloc() { inc(allocs); }
+    inline void onRetire() { inc(retires); }
+
+    void addTo(TxStats& st) const {
+        st.commits += commits.load(std::memory_order_relaxed);
+        st.abortsLoad += abortsLoad.load(std::memory_order_relaxed);
+        st.abortsCommit += abortsCommit.load(std::memory_order_relaxed);
+        st.abortsBegin += abortsBegin.load(std::memory_order_relaxed);
+        st.helps += helps.load(std::memory_order_relaxed);
+        st.helpBytes += helpBytes.load(std::memory_order_relaxed);
+        st.allocs += allocs.load(std::memory_order_relaxed);
+        st.retires += retires.load(std::memory_order_relaxed);
+        for (int i = 0; i < TxStats::WS_BUCKETS; i++) st.wsHistogram[i] += wsHistogram[i].load(std::memory_order_relaxed);
+    }
 };
 
-
-// A single entry in the write-set
-struct WriteSetEntry {
-    void*          addr {nullptr};  // Address of value+sequence to change
-    uint64_t       val;             // Desired value to change to
-    WriteSetEntry* next {nullptr};  // Pointer to next node in the (intrusive) hash map
+template<> struct TxCounters<false> {
+    inline void onCommit(uint64_t, uint64_t, uint64_t) { }
+    inline void onAbortLoad() { }
+    inline void onAbortCommit() { }
+    inline void onAbortBegin() { }
+    inline void onHelp(uint64_t) { }
+    inline void onAlloc() { }
+    inline void onRetire() { }
+    void addTo(TxStats&) const { }
 };
 
-extern thread_local bool tl_is_read_only;
 
+// Used to identify aborted transactions
+struct AbortedTx {};
+static constexpr AbortedTx AbortedTxException {};
 
-// The write-set is a log of the words modified during the transaction.
-// This log is an array with an intrusive hashmap of size HASH_BUCKETS.
-struct WriteSet {
-    static const uint64_t MAX_ARRAY_LOOKUP = 30;  // Beyond this, it seems to be faster to use the hashmap
-    WriteSetEntry         log[TX_MAX_STORES];     // Redo log of stores
-    uint64_t              numStores {0};          // Number of stores in the writeSet for the current transaction
-    WriteSetEntry*        buckets[HASH_BUCKETS];  // Intrusive HashMap for fast lookup in large(r) transactions
 
-    WriteSet() {
-        numStores = 0;
-        for (int i = 0; i < HASH_BUCKETS; i++) buckets[i] = &log[TX_MAX_STORES-1];
+// The engine with the configuration 'Config' (see DefaultConfig). Each configuration has its own instance of OneFileLF,
+// persistent region, thread registry and thread-local data, therefore, engines with different configurations can be
+// used in the same program, but a transaction of one engine can't access the tmtypes of another. The names in
+// namespace poflf, like poflf::OneFileLF and poflf::tmtype, are those of Engine<DefaultConfig>.
+template<typename Config> struct Engine {
+    // Maximum number of registered threads that can execute transactions. Compile with -DREGISTRY_CAPACITY=N to change it.
+    static constexpr int REGISTRY_MAX_THREADS = Config::registryThreads;
+    // Maximum number of stores in the WriteSet per transaction
+    static constexpr uint64_t TX_MAX_STORES = Config::maxStores;
+    // Initial number of slots in the index of the WriteSet. The index doubles whenever it gets half full.
+    static constexpr uint64_t TX_INDEX_SLOTS = Config::indexSlots;
+    // Number of stores up to which lookups in the WriteSet scan the log, instead of using the index. The index is only
+    // built once the log gets larger than this, and if TX_MAX_STORES isn't larger, the WriteSet has no index at all.
+    // Zero always uses the index.
+    static constexpr uint64_t TX_LINEAR_STORES = Config::linearStores;
+
+    // Persistent-specific configuration
+    // Name of persistent file mapping
+    static constexpr const char* PFILE_NAME = Config::fileName;
+    // Start address of mapped persistent memory
+    static inline uint8_t* const PREGION_ADDR = (uint8_t*)Config::regionAddr;
+    // Size of persistent memory. Part of it will be used by the redo logs
+    static constexpr uint64_t PREGION_SIZE = Config::regionSize;
+    // End address of mapped persistent memory
+    static inline uint8_t* const PREGION_END = (PREGION_ADDR+PREGION_SIZE);
+
+    // Number of bits of a transaction identifier that hold the index of the thread, the other bits hold the sequence.
+    // The default REGISTRY_MAX_THREADS fits in 10 bits, larger registries get 16 bits.
+    // Changing it changes the format of curTx in the persistent region.
+    static const uint64_t TX_IDX_BITS = (REGISTRY_MAX_THREADS <= 1024) ? 10 : 16;
+    static_assert(REGISTRY_MAX_THREADS <= (1 << 16), "REGISTRY_MAX_THREADS doesn't fit in the index of a transaction identifier");
+
+    // Functions to convert between a transaction identifier (uint64_t) and a pair of {sequence,index}
+    static inline uint64_t seqidx2trans(uint64_t seq, uint64_t idx) {
+        return (seq << TX_IDX_BITS) | idx;
+    }
+    static inline uint64_t trans2seq(uint64_t trans) {
+        return trans >> TX_IDX_BITS;
+    }
+    static inline uint64_t trans2idx(uint64_t trans) {
+        return trans & ((1ULL << TX_IDX_BITS)-1);
     }
 
-    // Copies the current write set to persistent memory
-    inline void persistAndFlushLog(PWriteSet* const pwset) {
-        for (uint64_t i = 0; i < numStores; i++) {
-            pwset->plog[i].addr = log[i].addr;
-            pwset->plog[i].val = log[i].val;
+    //
+    // Thread Registry stuff
+    //
+    static void thread_registry_deregister_thread(const int tid);
+
+    // An helper class to do the checkin and checkout of the thread registry
+    struct ThreadCheckInCheckOut {
+        static const int NOT_ASSIGNED = -1;
+        int tid { NOT_ASSIGNED };
+        ~ThreadCheckInCheckOut() {
+            if (tid == NOT_ASSIGNED) return;
+            thread_registry_deregister_thread(tid);
         }
-        pwset->numStores = numStores;
-        // Flush the log and the numStores variable
-        flushFromTo(&pwset->numStores, &pwset->plog[numStores+1]);
-    }
+    };
 
-    // Uses the log to flush the modifications to NVM.
-    // We assume tmtype does not cross cache line boundaries.
-    inline void flushModifications() {
-        for (uint64_t i = 0; i < numStores; i++) PWB(log[i].addr);
-    }
+    static thread_local ThreadCheckInCheckOut tl_tcico;
+
+    // Global/singleton instance, defined in Globals
+    class ThreadRegistry;
+    static ThreadRegistry& gThreadRegistry;
+
+    /*
+     * <h1> Registry for threads </h1>
+     *
+     * This is singleton type class that allows assignement of a unique id to each thread.
+     * The first time a thread calls ThreadRegistry::getTID() it will get the lowest free tid from 'tids' (see ThreadRegistryBitmap).
+     * This tid wil be saved in a thread-local variable of the type ThreadCheckInCheckOut which
+     * upon destruction of the thread will call the destructor of ThreadCheckInCheckOut and free the
+     * corresponding slot to be used by a later thread.
+     * The bitmap is shared with common/ThreadRegistry.hpp, so getMaxThreads() shrinks when threads exit and
+     * getUsedTIDs() lets scans skip the free tids.
+     */
+    class ThreadRegistry {
+    private:
+        ThreadRegistryBitmap<REGISTRY_MAX_THREADS> tids;
+
+    public:
+        // Progress condition: wait-free bounded (by the number of threads) to get the tid, lock-free to update maxTid
+        int register_thread_new(void) {
+            const int tid = tids.acquire();
+            if (tid == ThreadRegistryBitmap<REGISTRY_MAX_THREADS>::NO_TID) {
+                std::cout << "ERROR: Too many threads, registry can only hold " << REGISTRY_MAX_THREADS << " threads\n";
+                assert(false);
+            }
+            tl_tcico.tid = tid;
+            return tid;
+        }
 
-    // Each address on a different bucket
-    inline uint64_t hash(const void* addr) const {
-        return (((uint64_t)addr) >> 3) % HASH_BUCKETS;
-    }
+        // Progress condition: lock-free
+        inline void deregister_thread(const int tid) {
+            tids.release(tid);
+        }
 
-    // Adds a modification to the redo log
-    inline void addOrReplace(void* addr, uint64_t val) {
-        if (tl_is_read_only) tl_is_read_only = false;
-        const uint64_t hashAddr = hash(addr);
-        if (numStores < MAX_ARRAY_LOOKUP) {
-            // Lookup in array
-            for (unsigned int idx = 0; idx < numStores; idx++) {
-                if (log[idx].addr == addr) {
-                    log[idx].val = val;
-                    return;
-                }
+        // Progress condition: wait-free population oblivious
+        static inline uint64_t getMaxThreads(void) {
+            return gThreadRegistry.tids.getMaxThreads();
+        }
+
+        // Progress condition: wait-free population oblivious
+        // See ThreadRegistryBitmap::getUsedTIDs()
+        static inline uint64_t getUsedTIDs(const int w) {
+            return gThreadRegistry.tids.getUsedTIDs(w);
+        }
+
+        // Progress condition: wait-free bounded (by the number of threads)
+        static inline int getTID(void) {
+            int tid = tl_tcico.tid;
+            if (tid != ThreadCheckInCheckOut::NOT_ASSIGNED) return tid;
+            return gThreadRegistry.register_thread_new();
+        }
+    };
+
+
+    // Forward declaration needed by EsLoco
+    template<typename T> struct tmtype;
+
+    // The persistent write-set (undo log)
+    struct PWriteSet {
+        uint64_t              numStores {0};          // Number of stores in the writeSet for the current transaction
+        std::atomic<uint64_t> request {0};            // Can be moved to CLOSED by other threads, using a CAS
+        PWriteSetEntry        plog[TX_MAX_STORES];    // Redo log of stores
+
+        // Applies all entries in the log. Called only by recover() which is non-concurrent.
+        void applyFromRecover() {
+            // We're assuming that 'val' is the size of a uint64_t
+            for (uint64_t i = 0; i < numStores; i++) {
+                *((uint64_t*)plog[i].addr) = plog[i].val;
+                PWB(plog[i].addr);
             }
-        } else {
-            // Lookup in hashmap
-            WriteSetEntry* be = buckets[hashAddr];
-            if (be < &log[numStores] && hash(be->addr) == hashAddr) {
-                while (be != nullptr) {
-                    if (be->addr == addr) {
-                        be->val = val;
-                        return;
-                    }
-                    be = be->next;
+        }
+    };
+
+
+    // The persistent metadata is a 'header' that contains all the logs and the persistent curTx variable.
+    // It is located at the start of the persistent region, and the remaining region contains the data available for the allocator to use.
+    struct PMetadata {
+        static const uint64_t   MAGIC_ID = 0x1337babe;
+        std::atomic<uint64_t>   curTx {seqidx2trans(1,0)};
+        std::atomic<uint64_t>   pad1[15];
+        tmtypebase<void*>       rootPtrs[MAX_ROOT_POINTERS];
+        PWriteSet               plog[REGISTRY_MAX_THREADS];
+        uint64_t                id {0};
+        uint64_t                pad2 {0};
+    };
+
+
+    static thread_local bool tl_is_read_only;
+
+
+    // The write-set is a log of the words modified during the transaction.
+    // This log is an array with an open-addressing index of the addresses, to find them in the log.
+    struct WriteSet {
+        static const uint64_t INDEX_GROUP = 8;        // Number of tags compared at once when probing the index
+        static const uint64_t NO_ENTRY = ~0ULL;
+        static const uintptr_t DELTA = 1;             // Tag of the addr of the entries with the deltas of a tmcounter
+        static const uint64_t FILTER_SHIFT = 9;       // The bloom filter has 2^FILTER_SHIFT bits
+        static const uint64_t FILTER_BITS = 1ULL << FILTER_SHIFT;
+        static const bool     USE_INDEX = (TX_MAX_STORES > TX_LINEAR_STORES+1); // False if the log never outgrows TX_LINEAR_STORES
+        WriteSetEntry         log[TX_MAX_STORES];     // Redo log of stores
+        uint64_t              numStores {0};          // Number of stores in the writeSet for the current transaction
+        uint64_t              numDeltas {0};          // Number of entries with the deltas of a tmcounter, reset on the first store
+        std::vector<uint32_t> idxTags;                // Open-addressing index of the log: tag of the addr in each slot, zero if empty
+        std::vector<uint32_t> idxEntries;             // Position in the log of the entry in each slot of the index
+        std::vector<uint32_t> idxUsed;                // Slots taken in the current transaction, so that resetting the index is O(stores)
+        uint64_t              filter[FILTER_BITS/64]; // Bloom filter of the addresses in the log, reset on the first store
+
+        WriteSet() {
+            numStores = 0;
+            if (!USE_INDEX) return;
+            idxTags.resize(TX_INDEX_SLOTS, 0);
+            idxEntries.resize(TX_INDEX_SLOTS);
+        }
+
+        static_assert((TX_INDEX_SLOTS & (TX_INDEX_SLOTS-1)) == 0 && TX_INDEX_SLOTS >= INDEX_GROUP, "TX_INDEX_SLOTS must be a power of two");
+
+        // Copies the current write set to persistent memory
+        inline void persistAndFlushLog(PWriteSet* const pwset) {
+            for (uint64_t i = 0; i < numStores; i++) {
+                pwset->plog[i].addr = log[i].addr;
+                pwset->plog[i].val = log[i].val;
+            }
+            pwset->numStores = numStores;
+            // Flush the log and the numStores variable
+            flushFromTo(&pwset->numStores, &pwset->plog[numStores+1]);
+        }
+
+        // Sorts the log by address. This breaks the index, therefore, it can only be
+        // called once there are no more stores in the transaction.
+        inline void sortByAddress() {
+            std::sort(log, log + numStores, [] (const WriteSetEntry& a, const WriteSetEntry& b) { return a.addr < b.addr; });
+        }
+
+        // Uses the log to flush the modifications to NVM.
+        // We assume tmtype does not cross cache line boundaries. Consecutive entries in the same cache line, like
+        // the ones of tmMemset() and tmCopyArray(), are flushed only once.
+        inline void flushModifications() {
+            uintptr_t lastLine = 0;
+            for (uint64_t i = 0; i < numStores; i++) {
+                const uintptr_t line = (uintptr_t)log[i].addr & ~(uintptr_t)63;
+                if (line == lastLine) continue;
+                PWB(log[i].addr);
+                lastLine = line;
+            }
+        }
+
+        // Multiplicative hash of an addr (tmtypes are 16 bytes aligned). The bloom filter takes its two bits
+        // from the top of the hash, the index takes the first slot to probe from the middle and the tag from the bottom.
+        static inline uint64_t hash(const void* addr) {
+            return ((uint64_t)addr >> 4) * 0x9E3779B97F4A7C15ULL;
+        }
+
+        // Returns false if the addr with hash 'h' is surely not in the log, which is what happens for most loads
+        inline bool filterMayContain(const uint64_t h) const {
+            const uint64_t b1 = h >> (64-FILTER_SHIFT);
+            const uint64_t b2 = (h >> (64-2*FILTER_SHIFT)) & (FILTER_BITS-1);
+            return (filter[b1/64] & (1ULL << (b1%64))) && (filter[b2/64] & (1ULL << (b2%64)));
+        }
+
+        inline void filterAdd(const uint64_t h) {
+            const uint64_t b1 = h >> (64-FILTER_SHIFT);
+            const uint64_t b2 = (h >> (64-2*FILTER_SHIFT)) & (FILTER_BITS-1);
+            filter[b1/64] |= 1ULL << (b1%64);
+            filter[b2/64] |= 1ULL << (b2%64);
+        }
+
+        // Returns a bitmask of the slots in 'group' (INDEX_GROUP consecutive slots of the index) whose tag is 'tag'.
+        // The tags of the group are compared all at once with SIMD instructions.
+        static inline uint32_t matchGroup(const uint32_t* group, const uint32_t tag) {
+#if defined(__AVX2__)
+            const __m256i cmp = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)group), _mm256_set1_epi32(tag));
+            return _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+#elif defined(__SSE2__)
+            const __m128i vtag = _mm_set1_epi32(tag);
+            const __m128i lo = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)group), vtag);
+            const __m128i hi = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(group+4)), vtag);
+            return _mm_movemask_ps(_mm_castsi128_ps(lo)) | (_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4);
+#else
+            uint32_t mask = 0;
+            for (uint64_t i = 0; i < INDEX_GROUP; i++) if (group[i] == tag) mask |= 1U << i;
+            return mask;
+#endif
+        }
+
+        // Returns the position in the log of the entry for 'addr', or NO_ENTRY if it's not in the log.
+        // Up to TX_LINEAR_STORES entries, we scan the log, otherwise, we probe one group of slots after the other,
+        // until we find the addr or a group with an empty slot.
+        // Slots taken by previous transactions may still be in the index if there were no stores yet, hence the check on numStores.
+        inline uint64_t indexFind(const void* addr, const uint64_t h) {
+            if (!USE_INDEX || (TX_LINEAR_STORES != 0 && numStores <= TX_LINEAR_STORES)) {
+                for (uint64_t i = 0; i < numStores; i++) if (log[i].addr == addr) return i;
+                return NO_ENTRY;
+            }
+            const uint32_t tag = (uint32_t)h | 1;
+            const uint64_t mask = idxTags.size()-1;
+            for (uint64_t g = (h >> 32) & mask & ~(INDEX_GROUP-1);; g = (g + INDEX_GROUP) & mask) {
+                for (uint32_t m = matchGroup(&idxTags[g], tag); m != 0; m &= m-1) {
+                    const uint64_t eidx = idxEntries[g + __builtin_ctz(m)];
+                    if (eidx < numStores && log[eidx].addr == addr) return eidx;
                 }
+                if (matchGroup(&idxTags[g], 0) != 0) return NO_ENTRY;
             }
         }
-        // Add to array
-        WriteSetEntry* e = &log[numStores++];
-        assert(numStores < TX_MAX_STORES);
-        e->addr = addr;
-        e->val = val;
-        // Add to hashmap
-        WriteSetEntry* be = buckets[hashAddr];
-        // Clear if entry is from previous tx
-        e->next = (be < e && hash(be->addr) == hashAddr) ? be : nullptr;
-        buckets[hashAddr] = e;
-    }
 
-    // Does a lookup on the WriteSet for an addr.
-    // If the numStores is lower than MAX_ARRAY_LOOKUP, the lookup is done on the log, otherwise, the lookup is done on the hashmap.
-    // If it's not in the write-set, return lval.
-    inline uint64_t lookupAddr(const void* addr, uint64_t lval) {
-        if (numStores < MAX_ARRAY_LOOKUP) {
-            // Lookup in array
-            for (unsigned int idx = 0; idx < numStores; idx++) {
-                if (log[idx].addr == addr) return log[idx].val;
+        // Adds the entry at position 'eidx' of the log to the index, in the first empty slot
+        inline void indexInsert(const uint64_t h, const uint64_t eidx) {
+            const uint64_t mask = idxTags.size()-1;
+            for (uint64_t g = (h >> 32) & mask & ~(INDEX_GROUP-1);; g = (g + INDEX_GROUP) & mask) {
+                const uint32_t m = matchGroup(&idxTags[g], 0);
+                if (m == 0) continue;
+                const uint64_t slot = g + __builtin_ctz(m);
+                idxTags[slot] = (uint32_t)h | 1;
+                idxEntries[slot] = eidx;
+                idxUsed.push_back(slot);
+                return;
             }
-        } else {
-            // Lookup in hashmap
-            const uint64_t hashAddr = hash(addr);
-            WriteSetEntry* be = buckets[hashAddr];
-            if (be < &log[numStores] && hash(be->addr) == hashAddr) {
-                while (be != nullptr) {
-                    if (be->addr == addr) return be->val;
-                    be = be->next;
+        }
+
+        // Empties the index, touching only the slots taken since the last time it was emptied
+        inline void indexClear() {
+            for (uint32_t slot : idxUsed) idxTags[slot] = 0;
+            idxUsed.clear();
+        }
+
+        // Doubles the number of slots in the index until it has room for one more entry, and adds again all the entries of the log
+        inline void indexGrow() {
+            indexClear();
+            uint64_t slots = idxTags.size();
+            while (2*(numStores+1) > slots) slots *= 2;
+            idxTags.resize(slots, 0);
+            idxEntries.resize(slots);
+            for (uint64_t i = 0; i < numStores; i++) indexInsert(hash(log[i].addr), i);
+        }
+
+        // Adds a modification to the redo log
+        inline void addOrReplace(void* addr, uint64_t val) {
+            if (tl_is_read_only) tl_is_read_only = false;
+            // The log may have been reset since the last store, and so must the bloom filter and the index
+            if (numStores == 0) {
+                std::memset(filter, 0, sizeof(filter));
+                numDeltas = 0;
+                indexClear();
+            }
+            if (((size_t)addr & (0xFULL & ~DELTA)) != 0) {
+                printf("Alignment ERROR in addOrReplace() at address %p\n", addr);
+                assert(false);
+            }
+            const uint64_t h = hash(addr);
+            // Skip the lookup if the bloom filter says the addr is not in the log
+            if (filterMayContain(h)) {
+                const uint64_t eidx = indexFind(addr, h);
+                if (eidx != NO_ENTRY) {
+                    log[eidx].val = val;
+                    return;
                 }
             }
+            // Add to the log and to the index, which we keep at most half full. The index starts with the entry after
+            // the first TX_LINEAR_STORES, and gets those in indexGrow().
+            filterAdd(h);
+            const uint64_t eidx = numStores;
+            if (USE_INDEX && eidx >= TX_LINEAR_STORES) {
+                if ((TX_LINEAR_STORES != 0 && eidx == TX_LINEAR_STORES) || 2*(idxUsed.size()+1) > idxTags.size()) indexGrow();
+                indexInsert(h, eidx);
+            }
+            numStores++;
+            assert(numStores < TX_MAX_STORES);
+            log[eidx].addr = addr;
+            log[eidx].val = val;
         }
-        return lval;
-    }
 
-    // Assignment operator, used when making a copy of a WriteSet to help another thread
-    WriteSet& operator = (const WriteSet &other) {
-        numStores = other.numStores;
-        for (uint64_t i = 0; i < numStores; i++) log[i] = other.log[i];
-        return *this;
-    }
+        // Does a lookup on the WriteSet for an addr.
+        // If the bloom filter says the addr is not in the log, there is nothing else to do, otherwise, the lookup is done on the index.
+        // If it's not in the write-set, return lval.
+        inline uint64_t lookupAddr(const void* addr, uint64_t lval) {
+            const uint64_t h = hash(addr);
+            if (!filterMayContain(h)) return lval;
+            const uint64_t eidx = indexFind(addr, h);
+            return (eidx == NO_ENTRY) ? lval : log[eidx].val;
+        }
 
-    // Applies all entries in the log as DCASes.
-    // Seq must match for DCAS to succeed. This method is on the "hot-path".
-    inline void apply(uint64_t seq, const int tid) {
-        for (uint64_t i = 0; i < numStores; i++) {
-            // Use an heuristic to give each thread 8 consecutive DCAS to apply
-            WriteSetEntry& e = log[(tid*8 + i) % numStores];
-            tmtypebase<uint64_t>* tmte = (tmtypebase<uint64_t>*)e.addr;
-            uint64_t lval = tmte->val.load(std::memory_order_acquire);
-            uint64_t lseq = tmte->seq.load(std::memory_order_acquire);
-            if (lseq < seq) DCAS((uint64_t*)e.addr, lval, lseq, e.val, seq);
+        // Adds 'delta' to the tmcounter at 'addr'. If the counter has a store in the log, the delta is added to it,
+        // otherwise it goes to the entry of addr|DELTA (which has the same hash as addr), where the deltas of the
+        // transaction are summed up until foldDeltas().
+        inline void addDelta(void* addr, uint64_t delta) {
+            void* const daddr = (void*)((uintptr_t)addr | DELTA);
+            if (numStores != 0) {
+                const uint64_t h = hash(addr);
+                if (filterMayContain(h)) {
+                    uint64_t eidx = indexFind(addr, h);
+                    if (eidx == NO_ENTRY) eidx = indexFind(daddr, h);
+                    if (eidx != NO_ENTRY) {
+                        log[eidx].val += delta;
+                        return;
+                    }
+                }
+            }
+            addOrReplace(daddr, delta);
+            numDeltas++;
         }
-    }
-};
 
+        // Same as lookupAddr(), for a tmcounter: if the counter has no store in the log, returns lval plus the deltas
+        inline uint64_t lookupCounter(const void* addr, uint64_t lval) {
+            const uint64_t h = hash(addr);
+            if (!filterMayContain(h)) return lval;
+            uint64_t eidx = indexFind(addr, h);
+            if (eidx != NO_ENTRY) return log[eidx].val;
+            eidx = indexFind((void*)((uintptr_t)addr | DELTA), h);
+            return (eidx == NO_ENTRY) ? lval : lval + log[eidx].val;
+        }
 
-// Forward declaration
-struct OpData;
-// This is used by addOrReplace() to know which OpDesc instance to use for the current transaction
-extern thread_local OpData* tl_opdata;
+        // Replaces the entry with the deltas of each tmcounter by a store of its final value, which is then applied
+        // like any other store. Called by commitTx() before publishing the write-set: if another transaction modifies
+        // a counter after we've read it here, the CAS on curTx fails and the transaction is executed again.
+        inline void foldDeltas() {
+            for (uint64_t i = 0; i < numStores && numDeltas > 0; i++) {
+                WriteSetEntry& e = log[i];
+                if (((uintptr_t)e.addr & DELTA) == 0) continue;
+                e.addr = (void*)((uintptr_t)e.addr & ~DELTA);
+                e.val += ((tmtypebase<uint64_t>*)e.addr)->val.load(std::memory_order_acquire);
+                numDeltas--;
+            }
+        }
 
+        // Assignment operator, used when making a copy of a WriteSet to help another thread
+        WriteSet& operator = (const WriteSet &other) {
+            numStores = other.numStores;
+            for (uint64_t i = 0; i < numStores; i++) log[i] = other.log[i];
+            return *this;
+        }
 
-// Its purpose is to hold thread-local data
-struct OpData {
-    uint64_t      curTx {0};              // Used during a transaction to keep the value of curTx read in beginTx() (owner thread only)
-    uint64_t      nestedTrans {0};        // Thread-local: Number of nested transactions
-    PWriteSet*    pWriteSet {nullptr};    // Pointer to the redo log in persistent memory
-    uint64_t      padding[16-3];          // Padding to avoid false-sharing in nestedTrans and curTx
-};
+        // Applies all entries in the log as DCASes.
+        // Seq must match for DCAS to succeed. This method is on the "hot-path".
+        inline void apply(uint64_t seq, const int tid, const uint64_t prefetchDistance=TX_PREFETCH_DISTANCE) {
+            for (uint64_t i = 0; i < numStores; i++) {
+                // The words are (mostly) in random places in memory, so we prefetch the ones coming ahead
+                if (prefetchDistance != 0) __builtin_prefetch(log[(tid*8 + i + prefetchDistance) % numStores].addr, 1);
+                // Use an heuristic to give each thread 8 consecutive DCAS to apply
+                WriteSetEntry& e = log[(tid*8 + i) % numStores];
+                tmtypebase<uint64_t>* tmte = (tmtypebase<uint64_t>*)e.addr;
+                uint64_t lval = tmte->val.load(std::memory_order_acquire);
+                uint64_t lseq = tmte->seq.load(std::memory_order_acquire);
+                if (lseq < seq) DCAS((uint64_t*)e.addr, lval, lseq, e.val, seq);
+            }
+        }
+    };
 
 
-// Used to identify aborted transactions
-struct AbortedTx {};
-static constexpr AbortedTx AbortedTxException {};
+    // Forward declaration
+    struct OpData;
+    // This is used by addOrReplace() to know which OpDesc instance to use for the current transaction
+    static thread_local OpData* tl_opdata;
 
-class OneFileLF;
-extern OneFileLF gOFLF;
 
+    // Its purpose is to hold thread-local data.
+    // Each instance is allocated by its owner thread the first time it executes a transaction,
+    // therefore, threads that never execute a transaction don't take memory for a volatile write-set.
+    struct alignas(128) OpData {
+        uint64_t      curTx {0};              // Used during a transaction to keep the value of curTx read in beginTx() (owner thread only)
+        uint64_t      nestedTrans {0};        // Thread-local: Number of nested transactions
+        PWriteSet*    pWriteSet {nullptr};    // Pointer to the redo log in persistent memory
+        WriteSet      writeSet;               // Redo log of the current transaction, or a copy of the one we're helping
+        TxCounters<TX_STATS> stats;           // Transaction statistics of this thread (see TxStats)
+    };
 
-/**
- * <h1> One-File PTM (Lock-Free) </h1>
- *
- * One-File is a Persistent Software Transacional Memory with lock-free progress, meant to
- * implement lock-free data structures. It has integrated lock-free memory
- * reclamation using an optimistic memory scheme
- *
- * OF is a word-based PTM and it uses double-compare-and-swap (DCAS).
- *
- * Right now it has several limitations, some will be fixed in the future, some may be hard limitations of this approach:
- * - We can't have stack allocated tmtype<> variables. For example, we can't created inside a transaction "tmtpye<uint64_t> tmp = a;",
- *   it will give weird errors because of stack allocation.
- * - We need DCAS but it can be emulated with LL/SC or even with single-word CAS
- *   if we do redirection to a (lock-free) pool with SeqPtrs;
- */
-class OneFileLF {
-private:
-    static const bool                    debug = false;
-    OpData                              *opData;
-    int                                  fd {-1};
 
-public:
-    EsLoco<tmtype>                       esloco {};
-    PMetadata*                           pmd {nullptr};
-    std::atomic<uint64_t>*               curTx {nullptr};              // Pointer to persistent memory location of curTx (it's in PMetadata)
-    WriteSet*                            writeSets;                    // Two write-sets for each thread
-
-    OneFileLF() {
-        opData = new OpData[REGISTRY_MAX_THREADS];
-        writeSets = new WriteSet[REGISTRY_MAX_THREADS];
-        mapPersistentRegion(PFILE_NAME, PREGION_ADDR, PREGION_SIZE);
-    }
+    class OneFileLF;
+    static OneFileLF& gOFLF;
+
+
+    /**
+     * <h1> One-File PTM (Lock-Free) </h1>
+     *
+     * One-File is a Persistent Software Transacional Memory with lock-free progress, meant to
+     * implement lock-free data structures. It has integrated lock-free memory
+     * reclamation using an optimistic memory scheme
+     *
+     * OF is a word-based PTM and it uses double-compare-and-swap (DCAS).
+     *
+     * Right now it has several limitations, some will be fixed in the future, some may be hard limitations of this approach:
+     * - We can't have stack allocated tmtype<> variables. For example, we can't created inside a transaction "tmtpye<uint64_t> tmp = a;",
+     *   it will give weird errors because of stack allocation.
+     * - We need DCAS but it can be emulated with LL/SC or even with single-word CAS
+     *   if we do redirection to a (lock-free) pool with SeqPtrs;
+     */
+    class OneFileLF {
+    private:
+        static const bool                    debug = false;
+        std::atomic<OpData*>                 opData[REGISTRY_MAX_THREADS];  // Allocated by each thread on its first transaction
+        int                                  fd {-1};
+
+    public:
+        EsLoco<tmtype>                       esloco {};
+        PMetadata*                           pmd {nullptr};
+        std::atomic<uint64_t>*               curTx {nullptr};              // Pointer to persistent memory location of curTx (it's in PMetadata)
+
+        OneFileLF() {
+            for (unsigned i = 0; i < REGISTRY_MAX_THREADS; i++) opData[i].store(nullptr, std::memory_order_relaxed);
+            mapPersistentRegion(PFILE_NAME, PREGION_ADDR, PREGION_SIZE);
+        }
 
-    ~OneFileLF() {
-        delete[] opData;
-        delete[] writeSets;
-    }
+        ~OneFileLF() {
+            for (unsigned i = 0; i < REGISTRY_MAX_THREADS; i++) delete opData[i].load();
+        }
 
-    static std::string className() { return "OneFilePTM-LF"; }
-
-    void mapPersistentRegion(const char* filename, uint8_t* regionAddr, const uint64_t regionSize) {
-        // Check that the header with the logs leaves at least half the memory available to the user
-        if (sizeof(PMetadata) > regionSize/2) {
-            printf("ERROR: the size of the logs in persistent memory is so large that it takes more than half the whole persistent memory\n");
-            printf("Please reduce some of the settings in OneFilePTMLF.hpp and try again\n");
-            assert(false);
-        }
-        bool reuseRegion = false;
-        // Check if the file already exists or not
-        struct stat buf;
-        if (stat(filename, &buf) == 0) {
-            // File exists
-            fd = open(filename, O_RDWR|O_CREAT, 0755);
-            assert(fd >= 0);
-            reuseRegion = true;
-        } else {
-            // File doesn't exist
-            fd = open(filename, O_RDWR|O_CREAT, 0755);
-            assert(fd >= 0);
-            if (lseek(fd, regionSize-1, SEEK_SET) == -1) {
-                perror("lseek() error");
-            }
-            if (write(fd, "", 1) == -1) {
-                perror("write() error");
-            }
-        }
-        // mmap() memory range
-        void* got_addr = (uint8_t *)mmap(regionAddr, regionSize, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
-        if (got_addr == MAP_FAILED || got_addr != regionAddr) {
-            printf("got_addr = %p  instead of %p\n", got_addr, regionAddr);
-            perror("ERROR: mmap() is not working !!! ");
-            assert(false);
-        }
-        // Check if the header is consistent and only then can we attempt to re-use, otherwise we clear everything that's there
-        pmd = reinterpret_cast<PMetadata*>(regionAddr);
-        if (reuseRegion) reuseRegion = (pmd->id == PMetadata::MAGIC_ID);
-        // Map pieces of persistent Metadata to pointers in volatile memory
-        for (uint64_t i = 0; i < REGISTRY_MAX_THREADS; i++) opData[i].pWriteSet = &(pmd->plog[i]);
-        curTx = &(pmd->curTx);
-        // If the file has just been created or if the header is not consistent, clear everything.
-        // Otherwise, re-use and recover to a consistent state.
-        if (reuseRegion) {
-            esloco.init(regionAddr+sizeof(PMetadata), regionSize-sizeof(PMetadata), false);
-            //recover(); // Not needed on x86
-        } else {
-            // Start by resetting all tmtypes::seq in the metadata region
-            std::memset(regionAddr, 0, sizeof(PMetadata));
-            new (regionAddr) PMetadata();
-            esloco.init(regionAddr+sizeof(PMetadata), regionSize-sizeof(PMetadata), true);
-            PFENCE();
-            pmd->id = PMetadata::MAGIC_ID;
-            PWB(&pmd->id);
-            PFENCE();
+        static std::string className() { return "OneFilePTM-LF"; }
+
+        // Progress condition: wait-free population oblivious (apart from the allocation)
+        // Returns the OpData of thread 'tid', allocating it if this is the first transaction for this tid.
+        // The OpData is allocated and initialized by the owner thread so that, on a first-touch
+        // NUMA policy (the default in Linux), its pages are local to the node where the thread runs.
+        // When a thread de-registers, the next thread to get the same tid re-uses the OpData.
+        inline OpData& getOpData(const int tid) {
+            OpData* opd = opData[tid].load(std::memory_order_relaxed);
+            if (opd != nullptr) return *opd;
+            opd = new OpData();
+            opd->pWriteSet = &(pmd->plog[tid]);
+            opData[tid].store(opd, std::memory_order_release);
+            return *opd;
         }
-    }
 
-    // Progress Condition: lock-free
-    // The while-loop retarts only if there was at least one other thread completing a transaction
-    void beginTx(OpData& myopd, const int tid) {
-        tl_is_read_only = true;
-        while (true) {
-            myopd.curTx = curTx->load(std::memory_order_acquire);
-            helpApply(myopd.curTx, tid);
-            // Reset the write-set after (possibly) helping another transaction complete
-            writeSets[tid].numStores = 0;
-            // Start over if there is already a new transaction
-            if (myopd.curTx == curTx->load(std::memory_order_acquire)) return;
+        void mapPersistentRegion(const char* filename, uint8_t* regionAddr, const uint64_t regionSize) {
+            // Check that the header with the logs leaves at least half the memory available to the user
+            if (sizeof(PMetadata) > regionSize/2) {
+                printf("ERROR: the size of the logs in persistent memory is so large that it takes more than half the whole persistent memory\n");
+                printf("Please reduce some of the settings in OneFilePTMLF.hpp and try again\n");
+                assert(false);
+            }
+            bool reuseRegion = false;
+            // Check if the file already exists or not
+            struct stat buf;
+            if (stat(filename, &buf) == 0) {
+                // File exists
+                fd = open(filename, O_RDWR|O_CREAT, 0755);
+                assert(fd >= 0);
+                reuseRegion = true;
+            } else {
+                // File doesn't exist
+                fd = open(filename, O_RDWR|O_CREAT, 0755);
+                assert(fd >= 0);
+                if (lseek(fd, regionSize-1, SEEK_SET) == -1) {
+                    perror("lseek() error");
+                }
+                if (write(fd, "", 1) == -1) {
+                    perror("write() error");
+                }
+            }
+            // mmap() memory range
+            void* got_addr = (uint8_t *)mmap(regionAddr, regionSize, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+            if (got_addr == MAP_FAILED || got_addr != regionAddr) {
+                printf("got_addr = %p  instead of %p\n", got_addr, regionAddr);
+                perror("ERROR: mmap() is not working !!! ");
+                assert(false);
+            }
+            // Check if the header is consistent and only then can we attempt to re-use, otherwise we clear everything that's there
+            pmd = reinterpret_cast<PMetadata*>(regionAddr);
+            if (reuseRegion) reuseRegion = (pmd->id == PMetadata::MAGIC_ID);
+            // Map pieces of persistent Metadata to pointers in volatile memory. The redo logs are mapped in getOpData()
+            curTx = &(pmd->curTx);
+            // If the file has just been created or if the header is not consistent, clear everything.
+            // Otherwise, re-use and recover to a consistent state.
+            if (reuseRegion) {
+                esloco.init(regionAddr+sizeof(PMetadata), regionSize-sizeof(PMetadata), false);
+                //recover(); // Not needed on x86
+            } else {
+                // Start by resetting all tmtypes::seq in the metadata region
+                std::memset(regionAddr, 0, sizeof(PMetadata));
+                new (regionAddr) PMetadata();
+                esloco.init(regionAddr+sizeof(PMetadata), regionSize-sizeof(PMetadata), true);
+                PFENCE();
+                pmd->id = PMetadata::MAGIC_ID;
+                PWB(&pmd->id);
+                PFENCE();
+            }
         }
-    }
 
-    // Progress condition: wait-free population-oblivious
-    // Attempts to publish our write-set (commit the transaction) and then applies the write-set.
-    // Returns true if my transaction was committed.
-    inline bool commitTx(OpData& myopd, const int tid) {
-        // If it's a read-only transaction, then commit immediately
-        if (writeSets[tid].numStores == 0) return true;
-        // Give up if the curTx has changed sinced our transaction started
-        if (myopd.curTx != curTx->load(std::memory_order_acquire)) return false;
-        // Move our request to OPEN, using the sequence of the previous transaction +1
-        const uint64_t seq = trans2seq(myopd.curTx);
-        const uint64_t newTx = seqidx2trans(seq+1,tid);
-        myopd.pWriteSet->request.store(newTx, std::memory_order_release);
-        // Copy the write-set to persistent memory and flush it
-        writeSets[tid].persistAndFlushLog(myopd.pWriteSet);
-        // Attempt to CAS curTx to our OpDesc instance (tid) incrementing the seq in it
-        uint64_t lcurTx = myopd.curTx;
-        if (debug) printf("tid=%i  attempting CAS on curTx from (%ld,%ld) to (%ld,%ld)\n", tid, trans2seq(lcurTx), trans2idx(lcurTx), seq+1, (uint64_t)tid);
-        if (!curTx->compare_exchange_strong(lcurTx, newTx)) return false;
-        PWB(curTx);
-        // Execute each store in the write-set using DCAS() and close the request
-        helpApply(newTx, tid);
-        // We should need a PSYNC() here to provide durable linearizabilty, but the CAS of the state in helpApply() acts as a PSYNC() (on x86).
-        if (debug) printf("Committed transaction (%ld,%ld) with %ld stores\n", seq+1, (uint64_t)tid, writeSets[tid].numStores);
-        return true;
-    }
+        // Progress Condition: lock-free
+        // The while-loop retarts only if there was at least one other thread completing a transaction
+        void beginTx(OpData& myopd, const int tid) {
+            tl_is_read_only = true;
+            while (true) {
+                myopd.curTx = curTx->load(std::memory_order_acquire);
+                helpApply(myopd.curTx, tid);
+                // Reset the write-set after (possibly) helping another transaction complete
+                myopd.writeSet.numStores = 0;
+                // Start over if there is already a new transaction
+                if (myopd.curTx == curTx->load(std::memory_order_acquire)) return;
+                myopd.stats.onAbortBegin();
+            }
+        }
 
-    // Same as beginTx/endTx transaction, but with lambdas, and it handles AbortedTx exceptions
-    template<typename R, typename F> R transaction(F&& func) {
-        const int tid = ThreadRegistry::getTID();
-        OpData& myopd = opData[tid];
-        if (myopd.nestedTrans > 0) return func();
-        ++myopd.nestedTrans;
-        tl_opdata = &myopd;
-        R retval {};
-        while (true) {
-            beginTx(myopd, tid);
-            try {
-                retval = func();
-            } catch (AbortedTx&) {
-                continue;
-            }
-            if (commitTx(myopd, tid)) break;
-        }
-        tl_opdata = nullptr;
-        --myopd.nestedTrans;
-        return retval;
-    }
+        // Progress condition: wait-free population-oblivious
+        // Attempts to publish our write-set (commit the transaction) and then applies the write-set.
+        // Returns true if my transaction was committed.
+        inline bool commitTx(OpData& myopd, const int tid) {
+            // If it's a read-only transaction, then commit immediately
+            if (myopd.writeSet.numStores == 0) {
+                myopd.stats.onCommit(0, 0, 0);
+                return true;
+            }
+            // Give up if the curTx has changed sinced our transaction started
+            if (myopd.curTx != curTx->load(std::memory_order_acquire)) {
+                myopd.stats.onAbortCommit();
+                return false;
+            }
+            // Turn the deltas of the tmcounters into stores, now that the counters can't change unless our commit fails
+            if (myopd.writeSet.numDeltas > 0) myopd.writeSet.foldDeltas();
+            // Sort the log so that apply() touches the words of each node one after the other
+            if (TX_APPLY_SORTED) myopd.writeSet.sortByAddress();
+            // Move our request to OPEN, using the sequence of the previous transaction +1
+            const uint64_t seq = trans2seq(myopd.curTx);
+            const uint64_t newTx = seqidx2trans(seq+1,tid);
+            myopd.pWriteSet->request.store(newTx, std::memory_order_release);
+            // Copy the write-set to persistent memory and flush it
+            myopd.writeSet.persistAndFlushLog(myopd.pWriteSet);
+            // Attempt to CAS curTx to our OpDesc instance (tid) incrementing the seq in it
+            uint64_t lcurTx = myopd.curTx;
+            if (debug) printf("tid=%i  attempting CAS on curTx from (%ld,%ld) to (%ld,%ld)\n", tid, trans2seq(lcurTx), trans2idx(lcurTx), seq+1, (uint64_t)tid);
+            if (!curTx->compare_exchange_strong(lcurTx, newTx)) {
+                myopd.stats.onAbortCommit();
+                return false;
+            }
+            PWB(curTx);
+            // Execute each store in the write-set using DCAS() and close the request
+            helpApply(newTx, tid);
+            myopd.stats.onCommit(myopd.writeSet.numStores, 0, 0);
+            // We should need a PSYNC() here to provide durable linearizabilty, but the CAS of the state in helpApply() acts as a PSYNC() (on x86).
+            if (debug) printf("Committed transaction (%ld,%ld) with %ld stores\n", seq+1, (uint64_t)tid, myopd.writeSet.numStores);
+            return true;
+        }
+
+        // Same as beginTx/endTx transaction, but with lambdas, and it handles AbortedTx exceptions
+        template<typename R, typename F> R transaction(F&& func) {
+            const int tid = ThreadRegistry::getTID();
+            OpData& myopd = getOpData(tid);
+            if (myopd.nestedTrans > 0) return func();
+            ++myopd.nestedTrans;
+            tl_opdata = &myopd;
+            R retval {};
+            while (true) {
+                beginTx(myopd, tid);
+                try {
+                    retval = func();
+                } catch (AbortedTx&) {
+                    myopd.stats.onAbortLoad();
+                    continue;
+                }
+                if (commitTx(myopd, tid)) break;
+            }
+            tl_opdata = nullptr;
+            --myopd.nestedTrans;
+            return retval;
+        }
 
-    // Same as above, but returns void
-    template<typename F> void transaction(F&& func) {
-        const int tid = ThreadRegistry::getTID();
-        OpData& myopd = opData[tid];
-        if (myopd.nestedTrans > 0) {
-            func();
-            return;
-        }
-        ++myopd.nestedTrans;
-        tl_opdata = &myopd;
-        while (true) {
-            beginTx(myopd, tid);
-            try {
+        // Same as above, but returns void
+        template<typename F> void transaction(F&& func) {
+            const int tid = ThreadRegistry::getTID();
+            OpData& myopd = getOpData(tid);
+            if (myopd.nestedTrans > 0) {
                 func();
-            } catch (AbortedTx&) {
-                continue;
+                return;
             }
-            if (commitTx(myopd, tid)) break;
+            ++myopd.nestedTrans;
+            tl_opdata = &myopd;
+            while (true) {
+                beginTx(myopd, tid);
+                try {
+                    func();
+                } catch (AbortedTx&) {
+                    myopd.stats.onAbortLoad();
+                    continue;
+                }
+                if (commitTx(myopd, tid)) break;
+            }
+            tl_opdata = nullptr;
+            --myopd.nestedTrans;
         }
-        tl_opdata = nullptr;
-        --myopd.nestedTrans;
-    }
 
-    // It's silly that these have to be static, but we need them for the (SPS) benchmarks due to templatization
-    template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
-    template<typename R, typename F> static R readTx(F&& func) { return gOFLF.transaction<R>(func); }
-    template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
-    template<typename F> static void readTx(F&& func) { gOFLF.transaction(func); }
+        // Progress condition: wait-free bounded (by the number of threads)
+        // Returns the transaction statistics of this domain (see TxStats). Meant for statistics, it's not an atomic snapshot.
+        TxStats getTxStats() const {
+            TxStats st {};
+            for (unsigned i = 0; i < REGISTRY_MAX_THREADS; i++) {
+                const OpData* opd = opData[i].load(std::memory_order_acquire);
+                if (opd != nullptr) opd->stats.addTo(st);
+            }
+            return st;
+        }
 
-    template <typename T, typename... Args> static T* tmNew(Args&&... args) {
-    //template <typename T> static T* tmNew() {
-        T* ptr = (T*)gOFLF.esloco.malloc(sizeof(T));
-        //new (ptr) T;  // new placement
-        new (ptr) T(std::forward<Args>(args)...);
-        return ptr;
-    }
+        // It's silly that these have to be static, but we need them for the (SPS) benchmarks due to templatization
+        template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
+        template<typename R, typename F> static R readTx(F&& func) { return gOFLF.transaction<R>(func); }
+        template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
+        template<typename F> static void readTx(F&& func) { gOFLF.transaction(func); }
+
+        template <typename T, typename... Args> static T* tmNew(Args&&... args) {
+        //template <typename T> static T* tmNew() {
+            T* ptr = (T*)gOFLF.esloco.malloc(sizeof(T));
+            if (TX_STATS && tl_opdata != nullptr) tl_opdata->stats.onAlloc();
+            //new (ptr) T;  // new placement
+            new (ptr) T(std::forward<Args>(args)...);
+            return ptr;
+        }
 
-    template<typename T> static void tmDelete(T* obj) {
-        if (obj == nullptr) return;
-        obj->~T(); // Execute destructor as part of the current transaction
-        tmFree(obj);
-    }
+        template<typename T> static void tmDelete(T* obj) {
+            if (obj == nullptr) return;
+            obj->~T(); // Execute destructor as part of the current transaction
+            tmFree(obj);
+        }
 
-    static void* tmMalloc(size_t size) {
-        if (tl_opdata == nullptr) {
-            printf("ERROR: Can not allocate outside a transaction\n");
-            return nullptr;
+        static void* tmMalloc(size_t size) {
+            if (tl_opdata == nullptr) {
+                printf("ERROR: Can not allocate outside a transaction\n");
+                return nullptr;
+            }
+            void* obj = gOFLF.esloco.malloc(size);
+            tl_opdata->stats.onAlloc();
+            return obj;
         }
-        void* obj = gOFLF.esloco.malloc(size);
-        return obj;
-    }
 
-    static void tmFree(void* obj) {
-        if (obj == nullptr) return;
-        if (tl_opdata == nullptr) {
-            printf("ERROR: Can not de-allocate outside a transaction\n");
-            return;
+        static void tmFree(void* obj) {
+            if (obj == nullptr) return;
+            if (tl_opdata == nullptr) {
+                printf("ERROR: Can not de-allocate outside a transaction\n");
+                return;
+            }
+            tl_opdata->stats.onRetire();
+            gOFLF.esloco.free(obj);
         }
-        gOFLF.esloco.free(obj);
-    }
 
-    static void* pmalloc(size_t size) {
-        return gOFLF.esloco.malloc(size);
-    }
+        static void* pmalloc(size_t size) {
+            return gOFLF.esloco.malloc(size);
+        }
 
-    static void pfree(void* obj) {
-        if (obj == nullptr) return;
-        gOFLF.esloco.free(obj);
-    }
+        static void pfree(void* obj) {
+            if (obj == nullptr) return;
+            gOFLF.esloco.free(obj);
+        }
 
-    template <typename T> static inline T* get_object(int idx) {
-        tmtype<T*>* ptr = (tmtype<T*>*)&(gOFLF.pmd->rootPtrs[idx]);
-        return ptr->pload();
-    }
+        template <typename T> static inline T* get_object(int idx) {
+            tmtype<T*>* ptr = (tmtype<T*>*)&(gOFLF.pmd->rootPtrs[idx]);
+            return ptr->pload();
+        }
 
-    template <typename T> static inline void put_object(int idx, T* obj) {
-        tmtype<T*>* ptr = (tmtype<T*>*)&(gOFLF.pmd->rootPtrs[idx]);
-        ptr->pstore(obj);
-    }
+        template <typename T> static inline void put_object(int idx, T* obj) {
+            tmtype<T*>* ptr = (tmtype<T*>*)&(gOFLF.pmd->rootPtrs[idx]);
+            ptr->pstore(obj);
+        }
 
-private:
-    // Progress condition: wait-free population oblivious
-    inline void helpApply(uint64_t lcurTx, const int tid) {
-        const uint64_t idx = trans2idx(lcurTx);
-        const uint64_t seq = trans2seq(lcurTx);
-        OpData& opd = opData[idx];
-        // Nothing to apply unless the request matches the curTx
-        if (lcurTx != opd.pWriteSet->request.load(std::memory_order_acquire)) return;
-        if (idx != tid) {
-            // Make a copy of the write-set and check if it is consistent
-            writeSets[tid] = writeSets[idx];
-            std::atomic_thread_fence(std::memory_order_acquire);
-            if (lcurTx != curTx->load()) return;
+    private:
+        // Progress condition: wait-free population oblivious
+        inline void helpApply(uint64_t lcurTx, const int tid) {
+            const uint64_t idx = trans2idx(lcurTx);
+            const uint64_t seq = trans2seq(lcurTx);
+            OpData* const opdp = opData[idx].load(std::memory_order_acquire);
+            if (opdp == nullptr) {
+                // Thread idx has not done a transaction since we started (can happen after a restart), which means
+                // there is nothing in its volatile write-set. Close the request, as we would do for an empty write-set.
+                if (pmd->plog[idx].request.load() == lcurTx) {
+                    pmd->plog[idx].request.compare_exchange_strong(lcurTx, seqidx2trans(seq+1,idx));
+                }
+                return;
+            }
+            OpData& opd = *opdp;
+            OpData& myopd = *opData[tid].load(std::memory_order_relaxed);
+            WriteSet& myws = myopd.writeSet;
+            // Nothing to apply unless the request matches the curTx
             if (lcurTx != opd.pWriteSet->request.load(std::memory_order_acquire)) return;
+            if (idx != tid) {
+                // Make a copy of the write-set and check if it is consistent
+                myws = opd.writeSet;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (lcurTx != curTx->load()) return;
+                if (lcurTx != opd.pWriteSet->request.load(std::memory_order_acquire)) return;
+                myopd.stats.onHelp(myws.numStores*sizeof(WriteSetEntry));
+            }
+            if (debug) printf("Applying %ld stores in write-set\n", myws.numStores);
+            myws.apply(seq, tid);
+            myws.flushModifications();
+            if (opd.pWriteSet->request.load() == lcurTx) {
+                const uint64_t newReq = seqidx2trans(seq+1,idx);
+                opd.pWriteSet->request.compare_exchange_strong(lcurTx, newReq);
+            }
         }
-        if (debug) printf("Applying %ld stores in write-set\n", writeSets[tid].numStores);
-        writeSets[tid].apply(seq, tid);
-        writeSets[tid].flushModifications();
-        if (opd.pWriteSet->request.load() == lcurTx) {
-            const uint64_t newReq = seqidx2trans(seq+1,idx);
-            opd.pWriteSet->request.compare_exchange_strong(lcurTx, newReq);
+
+        // Upon restart, re-applies the last transaction, so as to guarantee that
+        // we have a consistent state in persistent memory.
+        // This is not used on x86 because the DCAS has atomicity writting to persistent memory.
+        void recover() {
+            uint64_t lcurTx = curTx->load(std::memory_order_acquire);
+            pmd->plog[trans2idx(lcurTx)].applyFromRecover();
+            PSYNC();
         }
-    }
+    };
 
-    // Upon restart, re-applies the last transaction, so as to guarantee that
-    // we have a consistent state in persistent memory.
-    // This is not used on x86 because the DCAS has atomicity writting to persistent memory.
-    void recover() {
-        uint64_t lcurTx = curTx->load(std::memory_order_acquire);
-        opData[trans2idx(lcurTx)].pWriteSet->applyFromRecover();
-        PSYNC();
-    }
-};
 
 
+    // T is typically a pointer to a node, but it can be integers or other stuff, as long as it fits in 64 bits
+    template<typename T> struct tmtype : tmtypebase<T> {
+        tmtype() { }
 
-// T is typically a pointer to a node, but it can be integers or other stuff, as long as it fits in 64 bits
-template<typename T> struct tmtype : tmtypebase<T> {
-    tmtype() { }
+        tmtype(T initVal) { pstore(initVal); }
 
-    tmtype(T initVal) { pstore(initVal); }
+        // Casting operator
+        operator T() { return pload(); }
 
-    // Casting operator
-    operator T() { return pload(); }
+        // Prefix increment operator: ++x
+        void operator++ () { pstore(pload()+1); }
+        // Prefix decrement operator: --x
+        void operator-- () { pstore(pload()-1); }
+        void operator++ (int) { pstore(pload()+1); }
+        void operator-- (int) { pstore(pload()-1); }
 
-    // Prefix increment operator: ++x
-    void operator++ () { pstore(pload()+1); }
-    // Prefix decrement operator: --x
-    void operator-- () { pstore(pload()-1); }
-    void operator++ (int) { pstore(pload()+1); }
-    void operator-- (int) { pstore(pload()-1); }
+        // Equals operator: first downcast to T and then compare
+        bool operator == (const T& otherval) const { return pload() == otherval; }
 
-    // Equals operator: first downcast to T and then compare
-    bool operator == (const T& otherval) const { return pload() == otherval; }
+        // Difference operator: first downcast to T and then compare
+        bool operator != (const T& otherval) const { return pload() != otherval; }
 
-    // Difference operator: first downcast to T and then compare
-    bool operator != (const T& otherval) const { return pload() != otherval; }
+        // Relational operators
+        bool operator < (const T& rhs) { return pload() < rhs; }
+        bool operator > (const T& rhs) { return pload() > rhs; }
+        bool operator <= (const T& rhs) { return pload() <= rhs; }
+        bool operator >= (const T& rhs) { return pload() >= rhs; }
 
-    // Relational operators
-    bool operator < (const T& rhs) { return pload() < rhs; }
-    bool operator > (const T& rhs) { return pload() > rhs; }
-    bool operator <= (const T& rhs) { return pload() <= rhs; }
-    bool operator >= (const T& rhs) { return pload() >= rhs; }
+        // Operator arrow ->
+        T operator->() { return pload(); }
 
-    // Operator arrow ->
-    T operator->() { return pload(); }
+        // Copy constructor
+        tmtype<T>(const tmtype<T>& other) { pstore(other.pload()); }
 
-    // Copy constructor
-    tmtype<T>(const tmtype<T>& other) { pstore(other.pload()); }
+        // Assignment operator from an tmtype
+        tmtype<T>& operator=(const tmtype<T>& other) {
+            pstore(other.pload());
+            return *this;
+        }
 
-    // Assignment operator from an tmtype
-    tmtype<T>& operator=(const tmtype<T>& other) {
-        pstore(other.pload());
-        return *this;
-    }
+        // Assignment operator from a value
+        tmtype<T>& operator=(T value) {
+            pstore(value);
+            return *this;
+        }
 
-    // Assignment operator from a value
-    tmtype<T>& operator=(T value) {
-        pstore(value);
-        return *this;
-    }
+        // Operator &
+        T* operator&() {
+            return (T*)this;
+        }
 
-    // Operator &
-    T* operator&() {
-        return (T*)this;
-    }
+        // Meant to be called when know we're the only ones touching
+        // these contents, for example, in the constructor of an object, before
+        // making the object visible to other threads.
+        inline void isolated_store(T newVal) {
+            tmtypebase<T>::val.store((uint64_t)newVal, std::memory_order_relaxed);
+        }
+
+        // We don't need to check curTx here because we're not de-referencing
+        // the val. It's only after a load() that the val may be de-referenced
+        // (in user code), therefore we do the check on load() only.
+        inline void pstore(T newVal) {
+            OpData* const myopd = tl_opdata;
+            if (myopd == nullptr) { // Looks like we're outside a transaction
+                tmtypebase<T>::val.store((uint64_t)newVal, std::memory_order_relaxed);
+            } else {
+                myopd->writeSet.addOrReplace(this, (uint64_t)newVal);
+            }
+        }
+
+        // We have to check if there is a new ongoing transaction and if so, abort
+        // this execution immediately for two reasons:
+        // 1. Memory Reclamation: the val we're returning may be a pointer to an
+        // object that has since been retired and deleted, therefore we can't allow
+        // user code to de-reference it;
+        // 2. Invariant Conservation: The val we're reading may be from a newer
+        // transaction, which implies that it may break an invariant in the user code.
+        // See examples of invariant breaking in this post:
+        // http://concurrencyfreaks.com/2013/11/stampedlocktryoptimisticread-and.html
+        inline T pload() const {
+            T lval = (T)tmtypebase<T>::val.load(std::memory_order_acquire);
+            OpData* const myopd = tl_opdata;
+            if (myopd == nullptr) return lval;
+            if ((uint8_t*)this < PREGION_ADDR || (uint8_t*)this > PREGION_END) return lval;
+            uint64_t lseq = tmtypebase<T>::seq.load(std::memory_order_acquire);
+            if (lseq > trans2seq(myopd->curTx)) throw AbortedTxException;
+            if (tl_is_read_only) return lval;
+            return (T)myopd->writeSet.lookupAddr(this, (uint64_t)lval);
+        }
+    };
+
+
+    // A 64 bit counter for sizes, statistics and sequence numbers, which many transactions update and few read.
+    // Updating the counter doesn't load it, so it doesn't need the counter to be unmodified since the transaction
+    // started: the deltas of a transaction are summed in a single entry of the write-set, which commitTx() turns
+    // into a store of the final value (see WriteSet::foldDeltas()). The counter is loaded and its 'seq' validated
+    // only if the transaction reads it, with pload().
+    struct tmcounter : tmtypebase<uint64_t> {
+        tmcounter() { }
 
-    // Meant to be called when know we're the only ones touching
-    // these contents, for example, in the constructor of an object, before
-    // making the object visible to other threads.
-    inline void isolated_store(T newVal) {
-        tmtypebase<T>::val.store((uint64_t)newVal, std::memory_order_relaxed);
+        // Inside a transaction, the initial value goes to the write-set, like in tmtype
+        tmcounter(uint64_t initVal) {
+            OpData* const myopd = tl_opdata;
+            if (myopd == nullptr) val.store(initVal, std::memory_order_relaxed);
+            else myopd->writeSet.addOrReplace(this, initVal);
+        }
+
+        // Casting operator
+        operator uint64_t() { return pload(); }
+
+        // Increment and decrement operators
+        void operator++ () { add(1); }
+        void operator-- () { add(-1); }
+        void operator++ (int) { add(1); }
+        void operator-- (int) { add(-1); }
+        tmcounter& operator+=(int64_t delta) { add(delta); return *this; }
+        tmcounter& operator-=(int64_t delta) { add(-delta); return *this; }
+
+        // Meant to be called when know we're the only ones touching the counter,
+        // for example, in the constructor of an object, before making the object
+        // visible to other threads.
+        inline void isolated_store(uint64_t newVal) {
+            val.store(newVal, std::memory_order_relaxed);
+        }
+
+        // Adds 'delta' (which can be negative) to the counter, without loading it
+        inline void add(int64_t delta) {
+            OpData* const myopd = tl_opdata;
+            if (myopd == nullptr) { // Looks like we're outside a transaction
+                val.store(val.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+            } else {
+                myopd->writeSet.addDelta(this, (uint64_t)delta);
+            }
+        }
+
+        // Adds 'delta' to the counter and returns its previous value, to generate sequence numbers.
+        // Unlike add(), this loads the counter.
+        inline uint64_t fetchAdd(int64_t delta) {
+            const uint64_t prev = pload();
+            add(delta);
+            return prev;
+        }
+
+        // Same as tmtype::pload(), plus the deltas of the current transaction
+        inline uint64_t pload() const {
+            uint64_t lval = val.load(std::memory_order_acquire);
+            OpData* const myopd = tl_opdata;
+            if (myopd == nullptr) return lval;
+            if ((uint8_t*)this < PREGION_ADDR || (uint8_t*)this > PREGION_END) return lval;
+            uint64_t lseq = seq.load(std::memory_order_acquire);
+            if (lseq > trans2seq(myopd->curTx)) throw AbortedTxException;
+            if (tl_is_read_only) return lval;
+            return myopd->writeSet.lookupCounter(this, lval);
+        }
+    };
+
+
+    //
+    // Wrapper methods to the TM instance of this configuration. The user should use these:
+    //
+    template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
+    template<typename R, typename F> static R readTx(F&& func) { return gOFLF.transaction<R>(func); }
+    template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
+    template<typename F> static void readTx(F&& func) { gOFLF.transaction(func); }
+    template<typename T, typename... Args> static T* tmNew(Args&&... args) { return OneFileLF::template tmNew<T>(std::forward<Args>(args)...); }
+    template<typename T> static void tmDelete(T* obj) { OneFileLF::template tmDelete<T>(obj); }
+    template<typename T> static T* get_object(int idx) { return OneFileLF::template get_object<T>(idx); }
+    template<typename T> static void put_object(int idx, T* obj) { OneFileLF::template put_object<T>(idx, obj); }
+    static inline void* tmMalloc(size_t size) { return OneFileLF::tmMalloc(size); }
+    static inline void tmFree(void* obj) { OneFileLF::tmFree(obj); }
+
+
+    //
+    // Bulk stores over arrays of tmtypes, which check the transaction once for the whole array instead of once per element.
+    // Each element takes one entry of the write-set, like with a store, but the entries of an array are next to each
+    // other in the log, so flushModifications() flushes each cache line of the array only once.
+    //
+
+    // Stores 'val' in the 'n' elements of 'dst'
+    template<typename T> static void tmMemset(tmtype<T>* dst, T val, size_t n) {
+        OpData* const myopd = tl_opdata;
+        if (myopd == nullptr) {
+            for (size_t i = 0; i < n; i++) dst[i].isolated_store(val);
+        } else {
+            for (size_t i = 0; i < n; i++) myopd->writeSet.addOrReplace(dst+i, (uint64_t)val);
+        }
     }
 
-    // We don't need to check curTx here because we're not de-referencing
-    // the val. It's only after a load() that the val may be de-referenced
-    // (in user code), therefore we do the check on load() only.
-    inline void pstore(T newVal) {
+    // Copies 'n' values from (non-transactional) memory at 'src' to the elements of 'dst'
+    template<typename T> static void tmMemcpy(tmtype<T>* dst, const T* src, size_t n) {
         OpData* const myopd = tl_opdata;
-        if (myopd == nullptr) { // Looks like we're outside a transaction
-            tmtypebase<T>::val.store((uint64_t)newVal, std::memory_order_relaxed);
+        if (myopd == nullptr) {
+            for (size_t i = 0; i < n; i++) dst[i].isolated_store(src[i]);
         } else {
-            gOFLF.writeSets[tl_tcico.tid].addOrReplace(this, (uint64_t)newVal);
+            for (size_t i = 0; i < n; i++) myopd->writeSet.addOrReplace(dst+i, (uint64_t)src[i]);
         }
     }
 
-    // We have to check if there is a new ongoing transaction and if so, abort
-    // this execution immediately for two reasons:
-    // 1. Memory Reclamation: the val we're returning may be a pointer to an
-    // object that has since been retired and deleted, therefore we can't allow
-    // user code to de-reference it;
-    // 2. Invariant Conservation: The val we're reading may be from a newer
-    // transaction, which implies that it may break an invariant in the user code.
-    // See examples of invariant breaking in this post:
-    // http://concurrencyfreaks.com/2013/11/stampedlocktryoptimisticread-and.html
-    inline T pload() const {
-        T lval = (T)tmtypebase<T>::val.load(std::memory_order_acquire);
+    // Copies the 'n' elements of 'src' to the elements of 'dst'. The arrays may overlap, like in std::memmove().
+    template<typename T> static void tmCopyArray(tmtype<T>* dst, const tmtype<T>* src, size_t n) {
         OpData* const myopd = tl_opdata;
-        if (myopd == nullptr) return lval;
-        if ((uint8_t*)this < PREGION_ADDR || (uint8_t*)this > PREGION_END) return lval;
-        uint64_t lseq = tmtypebase<T>::seq.load(std::memory_order_acquire);
-        if (lseq > trans2seq(myopd->curTx)) throw AbortedTxException;
-        if (tl_is_read_only) return lval;
-        return (T)gOFLF.writeSets[tl_tcico.tid].lookupAddr(this, (uint64_t)lval);
+        for (size_t j = 0; j < n; j++) {
+            const size_t i = (dst > src) ? n-1-j : j;
+            const T lval = src[i].pload();
+            if (myopd == nullptr) dst[i].isolated_store(lval);
+            else myopd->writeSet.addOrReplace(dst+i, (uint64_t)lval);
+        }
     }
+
+
+    // The instances of this configuration, in a single object so that they are constructed in this order and destroyed
+    // in the reverse order
+    struct Globals {
+        OneFileLF  engine {};
+        ThreadRegistry threadRegistry {};
+    };
+    static Globals globals;
 };
 
 
 //
-// Wrapper methods to the global TM instance. The user should use these:
+// Static members of the engine
+//
+template<typename Config> typename Engine<Config>::OneFileLF& Engine<Config>::gOFLF = Engine<Config>::globals.engine;
+template<typename Config> thread_local typename Engine<Config>::OpData* Engine<Config>::tl_opdata {nullptr};
+// Global/singleton to hold all the thread registry functionality
+template<typename Config> typename Engine<Config>::ThreadRegistry& Engine<Config>::gThreadRegistry = Engine<Config>::globals.threadRegistry;
+// During a transaction, this is true up until the first store()
+template<typename Config> thread_local bool Engine<Config>::tl_is_read_only {false};
+// This is where every thread stores the tid it has been assigned when it calls getTID() for the first time.
+// When the thread dies, the destructor of ThreadCheckInCheckOut will be called and de-register the thread.
+template<typename Config> thread_local typename Engine<Config>::ThreadCheckInCheckOut Engine<Config>::tl_tcico {};
+// Helper function for thread de-registration
+template<typename Config> void Engine<Config>::thread_registry_deregister_thread(const int tid) {
+    gThreadRegistry.deregister_thread(tid);
+}
+// The instances of the other configurations are constructed with the dynamic initialization of the program,
+// in no particular order with the globals of the user
+template<typename Config> typename Engine<Config>::Globals Engine<Config>::globals {};
+
+
 //
+// Place these in a .cpp if you include this header from multiple files (compilation units)
+//
+// The instances of the default configuration are constructed before the globals that follow the include of this header
+template<> Engine<DefaultConfig>::Globals Engine<DefaultConfig>::globals {};
+
+
+//
+// The engine with the default configuration. These are the names used by the benchmarks, and by the data structures
+// that aren't given a configuration.
+//
+typedef Engine<DefaultConfig>::OneFileLF OneFileLF;
+typedef Engine<DefaultConfig>::ThreadRegistry ThreadRegistry;
+typedef Engine<DefaultConfig>::tmcounter tmcounter;
+template<typename T> using tmtype = Engine<DefaultConfig>::tmtype<T>;
+static const int REGISTRY_MAX_THREADS = Engine<DefaultConfig>::REGISTRY_MAX_THREADS;
+inline OneFileLF& gOFLF = Engine<DefaultConfig>::gOFLF;
+
+// Wrapper methods to the default TM instance. The user should use these:
 template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
 template<typename R, typename F> static R readTx(F&& func) { return gOFLF.transaction<R>(func); }
 template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
@@ -916,24 +1417,10 @@ template<typename T> static T* get_object(int idx) { return OneFileLF::get_objec
 template<typename T> static void put_object(int idx, T* obj) { OneFileLF::put_object<T>(idx, obj); }
 inline static void* tmMalloc(size_t size) { return OneFileLF::tmMalloc(size); }
 inline static void tmFree(void* obj) { OneFileLF::tmFree(obj); }
+template<typename T> void tmMemset(tmtype<T>* dst, T val, size_t n) { Engine<DefaultConfig>::tmMemset(dst, val, n); }
+template<typename T> void tmMemcpy(tmtype<T>* dst, const T* src, size_t n) { Engine<DefaultConfig>::tmMemcpy(dst, src, n); }
+template<typename T> void tmCopyArray(tmtype<T>* dst, const tmtype<T>* src, size_t n) { Engine<DefaultConfig>::tmCopyArray(dst, src, n); }
 
-
-//
-// Place these in a .cpp if you include this header from multiple files (compilation units)
-//
-OneFileLF gOFLF {};
-thread_local OpData* tl_opdata {nullptr};
-// Global/singleton to hold all the thread registry functionality
-ThreadRegistry gThreadRegistry {};
-// During a transaction, this is true up until the first store()
-thread_local bool tl_is_read_only {false};
-// This is where every thread stores the tid it has been assigned when it calls getTID() for the first time.
-// When the thread dies, the destructor of ThreadCheckInCheckOut will be called and de-register the thread.
-thread_local ThreadCheckInCheckOut tl_tcico {};
-// Helper function for thread de-registration
-void thread_registry_deregister_thread(const int tid) {
-    gThreadRegistry.deregister_thread(tid);
-}
-
+} // inline namespace POFLF_CONFIG_NS
 }
 #endif /* _PERSISTENT_ONE_FILE_LOCK_FREE_TRANSACTIONAL_MEMORY_H_ */
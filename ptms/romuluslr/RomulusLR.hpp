@@ -92,9 +92,14 @@ public:
         states[tid*CLPAD].store(NOT_READING, std::memory_order_release);
     }
 
+    // Only the threads in use can be reading
     inline bool isEmpty() noexcept {
-        for (int tid = 0; tid < ThreadRegistry::getMaxThreads(); tid++) {
-            if (states[tid*CLPAD].load() != NOT_READING) return false;
+        const int maxTid = ThreadRegistry::getMaxThreads();
+        for (int w = 0; w*64 < maxTid; w++) {
+            for (uint64_t used = ThreadRegistry::getUsedTIDs(w); used != 0; used &= used-1) {
+                const int tid = w*64 + __builtin_ctzll(used);
+                if (states[tid*CLPAD].load() != NOT_READING) return false;
+            }
         }
         return true;
     }
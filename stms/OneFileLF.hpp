@@ -14,29 +14,110 @@
 #include <cassert>
 #include <iostream>
 #include <vector>
+#include <array>
 #include <functional>
 #include <cstring>
 #include <cstdint>   // Needed by uint64_t
+#include <algorithm> // Needed by std::min and std::sort
+#include <immintrin.h> // Needed by the SIMD probing of the WriteSet index
+#include <chrono>      // Needed by the counters of HazardErasOF
+#include <new>         // Needed by std::bad_alloc
+#include <mutex>       // Needed by ConflictProfiler
+#include <map>
+#include <string>
+#include <sstream>
+#include <typeinfo>    // Needed by typeid
+#include <cxxabi.h>    // Needed by abi::__cxa_demangle
+#include <type_traits>
+#include "../common/ThreadRegistryBitmap.hpp"
 
 // Please keep this file in sync (as much as possible) with ptms/POneFileLF.hpp
 
+// The engine is defined in an inline namespace named after the capacity of the registry, which changes DefaultConfig
+// (see below). Translation units compiled with different values of REGISTRY_CAPACITY then don't share incompatible
+// definitions under the same names, and mixing them fails to link instead of silently breaking the One Definition Rule.
+#define OFLF_NS_CAT_(a,b) a##b
+#define OFLF_NS_CAT(a,b) OFLF_NS_CAT_(a,b)
+#ifdef REGISTRY_CAPACITY
+#define OFLF_CONFIG_NS OFLF_NS_CAT(cfg_default_, REGISTRY_CAPACITY)
+#else
+#define OFLF_CONFIG_NS cfg_default
+#endif
+
 namespace oflf {
+inline namespace OFLF_CONFIG_NS {
 
 //
 // User configurable variables.
 // Feel free to change these if you need larger transactions, more allocations per transacation, or more threads.
 //
 
-// Maximum number of registered threads that can execute transactions
-static const int REGISTRY_MAX_THREADS = 128;
-// Maximum number of stores in the WriteSet per transaction
-static const uint64_t TX_MAX_STORES = 10*1024;
-// Number of buckets in the hashmap of the WriteSet.
-static const uint64_t HASH_BUCKETS = 1024;
-// Maximum number of allocations in one transaction
-static const uint64_t TX_MAX_ALLOCS = 10*1024;
-// Maximum number of deallocations in one transaction
-static const uint64_t TX_MAX_RETIRES = 10*1024;
+// Configuration policy with the capacities of the engine, which Engine<Config> takes its constants from (see them for
+// what each member means). To size the engine for a particular workload, declare a struct with the same members and
+// use it as the Config of Engine and of the data structures. Engines with different configurations are independent
+// from each other, and can be used in the same program.
+struct DefaultConfig {
+#ifdef REGISTRY_CAPACITY
+    static constexpr int      registryThreads = REGISTRY_CAPACITY;
+#else
+    static constexpr int      registryThreads = 128;
+#endif
+    static constexpr uint64_t chunkStores = 512;
+    static constexpr uint64_t keepChunks = 4;
+    static constexpr uint64_t indexSlots = 64;
+    static constexpr uint64_t linearStores = 0;
+    static constexpr uint64_t captureAllocs = 4;
+    static constexpr uint64_t cacheMaxSize = 1024;
+    static constexpr uint64_t cacheBlocks = 256;
+};
+// Number of objects a thread retires between two scans of its retired list by Hazard Eras
+static const uint64_t TX_RECLAIM_THRESHOLD = 128;
+// Number of entries ahead of the current one that WriteSet::apply() prefetches (for write). Zero disables prefetching.
+static const uint64_t TX_PREFETCH_DISTANCE = 8;
+// If true, the WriteSet is sorted by address before being published, so that apply() touches the words of a node one
+// after the other, instead of in the order they were stored.
+static const bool TX_APPLY_SORTED = false;
+// Number of stores each thread claims at a time when applying a large WriteSet. Must be a divisor of TX_CHUNK_STORES.
+static const uint64_t TX_APPLY_STORES = 64;
+// Default for the commit combining mode of new OneFileLF instances (see OneFileLF::OneFileLF()).
+static const bool TX_COMBINING = false;
+// Contention management policies for the retries of OneFileLF::transaction() (see OneFileLF::contentionAbort())
+enum ContentionPolicy {
+    CM_NONE,        // Retry immediately
+    CM_BACKOFF,     // Randomized exponential backoff after each abort
+    CM_KARMA,       // Backoff, and priority to a transaction that has aborted TX_KARMA_ABORTS times in a row
+};
+// Default contention management policy of new OneFileLF instances
+static const ContentionPolicy TX_CONTENTION = CM_NONE;
+// Number of pause instructions of the first backoff. Each consecutive abort doubles it, up to TX_BACKOFF_MAX.
+static const uint64_t TX_BACKOFF_MIN = 8;
+static const uint64_t TX_BACKOFF_MAX = 1024;
+// Number of consecutive aborts after which a transaction gets priority over the others, with CM_KARMA
+static const uint64_t TX_KARMA_ABORTS = 8;
+// Default for the hybrid mode of new OneFileLF instances (see OneFileLF::setHybrid()).
+static const bool TX_HYBRID = false;
+// Number of consecutive aborts after which a transaction switches to the announce-and-help path, in the hybrid mode
+static const uint64_t TX_HYBRID_ABORTS = 4;
+// Maximum number of operations that a batch (see OneFileLF::updateTransactionBatch()) executes in a single transaction
+static const uint64_t TX_BATCH_MAX_OPS = 64;
+// Number of stores that a batch aims for in the write-set of each of its transactions
+static const uint64_t TX_BATCH_STORES = 256;
+// Per-thread transaction statistics (see TxStats). Compile with -DTX_STATS_ENABLED to collect them, otherwise the
+// counters are compiled out and cost nothing.
+#ifdef TX_STATS_ENABLED
+static const bool TX_STATS = true;
+#else
+static const bool TX_STATS = false;
+#endif
+// Sampling profiler of the addresses where transactions abort (see ConflictProfiler). Compile with
+// -DTX_PROFILE_ENABLED to enable it, otherwise it is compiled out and costs nothing.
+#ifdef TX_PROFILE_ENABLED
+static const bool TX_PROFILE = true;
+#else
+static const bool TX_PROFILE = false;
+#endif
+// One in every TX_PROFILE_PERIOD aborts of each thread is sampled by the profiler
+static const uint64_t TX_PROFILE_PERIOD = 16;
 
 
 
@@ -56,98 +137,6 @@ static const uint64_t TX_MAX_RETIRES = 10*1024;
     __ret; })
 
 
-// Functions to convert between a transaction identifier (uint64_t) and a pair of {sequence,index}
-static inline uint64_t seqidx2trans(uint64_t seq, uint64_t idx) {
-    return (seq << 10) | idx;
-}
-static inline uint64_t trans2seq(uint64_t trans) {
-    return trans >> 10;
-}
-static inline uint64_t trans2idx(uint64_t trans) {
-    return trans & 0x3FF; // 10 bits
-}
-
-
-//
-// Thread Registry stuff
-//
-extern void thread_registry_deregister_thread(const int tid);
-
-// An helper class to do the checkin and checkout of the thread registry
-struct ThreadCheckInCheckOut {
-    static const int NOT_ASSIGNED = -1;
-    int tid { NOT_ASSIGNED };
-    ~ThreadCheckInCheckOut() {
-        if (tid == NOT_ASSIGNED) return;
-        thread_registry_deregister_thread(tid);
-    }
-};
-
-extern thread_local ThreadCheckInCheckOut tl_tcico;
-
-// Forward declaration of global/singleton instance
-class ThreadRegistry;
-extern ThreadRegistry gThreadRegistry;
-
-/*
- * <h1> Registry for threads </h1>
- *
- * This is singleton type class that allows assignement of a unique id to each thread.
- * The first time a thread calls ThreadRegistry::getTID() it will allocate a free slot in 'usedTID[]'.
- * This tid wil be saved in a thread-local variable of the type ThreadCheckInCheckOut which
- * upon destruction of the thread will call the destructor of ThreadCheckInCheckOut and free the
- * corresponding slot to be used by a later thread.
- */
-class ThreadRegistry {
-private:
-    alignas(128) std::atomic<bool>      usedTID[REGISTRY_MAX_THREADS];   // Which TIDs are in use by threads
-    alignas(128) std::atomic<int>       maxTid {-1};                     // Highest TID (+1) in use by threads
-
-public:
-    ThreadRegistry() {
-        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
-            usedTID[it].store(false, std::memory_order_relaxed);
-        }
-    }
-
-    // Progress condition: wait-free bounded (by the number of threads)
-    int register_thread_new(void) {
-        for (int tid = 0; tid < REGISTRY_MAX_THREADS; tid++) {
-            if (usedTID[tid].load(std::memory_order_acquire)) continue;
-            bool unused = false;
-            if (!usedTID[tid].compare_exchange_strong(unused, true)) continue;
-            // Increase the current maximum to cover our thread id
-            int curMax = maxTid.load();
-            while (curMax <= tid) {
-                maxTid.compare_exchange_strong(curMax, tid+1);
-                curMax = maxTid.load();
-            }
-            tl_tcico.tid = tid;
-            return tid;
-        }
-        std::cout << "ERROR: Too many threads, registry can only hold " << REGISTRY_MAX_THREADS << " threads\n";
-        assert(false);
-    }
-
-    // Progress condition: wait-free population oblivious
-    inline void deregister_thread(const int tid) {
-        usedTID[tid].store(false, std::memory_order_release);
-    }
-
-    // Progress condition: wait-free population oblivious
-    static inline uint64_t getMaxThreads(void) {
-        return gThreadRegistry.maxTid.load(std::memory_order_acquire);
-    }
-
-    // Progress condition: wait-free bounded (by the number of threads)
-    static inline int getTID(void) {
-        int tid = tl_tcico.tid;
-        if (tid != ThreadCheckInCheckOut::NOT_ASSIGNED) return tid;
-        return gThreadRegistry.register_thread_new();
-    }
-};
-
-
 // Each object tracked by Hazard Eras needs to have tmbase as one of its base classes.
 struct tmbase {
     uint64_t newEra_ {0};        // Filled by tmNew() or tmMalloc()
@@ -155,109 +144,207 @@ struct tmbase {
 };
 
 
+// A transaction announced by a thread in the commit combining mode, so that other threads can execute it.
+// It has to be allocated with tl_cache because Hazard Eras reclaims it without calling the destructor. The lambda is stored in the derived TransFuncOf, behind the type-erased 'call'.
+struct TransFunc : public tmbase {
+    uint64_t (*call)(TransFunc*);
+};
+
+
 // One entry in the log of allocations (not used for retires like in the WF version).
 // In case the transactions aborts, we can rollback our allocations, hiding the type information inside the lambda.
 // Sure, we could keep everything in std::function, but this uses less memory.
 struct Deletable {
     void* obj {nullptr};         // Pointer to object to be deleted
     void (*reclaim)(void*);      // A wrapper to keep the type of the underlying object
+    uint64_t size;               // Size of the allocation, used to know which stores are captured
 };
 
 
-// This is a specialized implementation of Hazard Eras meant to be used in the OneFile STM.
-// Hazard Eras is a lock-free memory reclamation technique described here:
-// https://github.com/pramalhe/ConcurrencyFreaks/blob/master/papers/hazarderas-2017.pdf
-// https://dl.acm.org/citation.cfm?id=3087588
-//
-// We're using OneFileLF::curTx.seq as the global era.
-class HazardErasOF {
-private:
-    static const uint64_t                    NOERA = 0;
-    static const int                         CLPAD = 128/sizeof(std::atomic<uint64_t>);
-    static const int                         THRESHOLD_R = 0; // This is named 'R' in the HP paper
-    alignas(128) std::atomic<uint64_t>*      he;
-    // It's not nice that we have a lot of empty vectors, but we need padding to avoid false sharing
-    alignas(128) std::vector<tmbase*>        retiredList[REGISTRY_MAX_THREADS*CLPAD];
+// Sampling profiler of the conflicts that abort transactions, to find which words of a data structure are hot.
+// One in every TX_PROFILE_PERIOD aborts of each thread in tmtype::pload() is sampled, and the address of the
+// tmtype is resolved to the object that contains it, using the type (or size) given to tmNew() (or tmMalloc()),
+// which register their allocations when the profiler is enabled. The samples are aggregated by type and offset,
+// and a ranked report is printed at exit, or by calling printReport().
+// By the time a transaction sees the conflict, the write-set of the transaction that caused it has been applied
+// and may be reused, so the overlap between the two is approximated: the conflict is counted as write-write if
+// the aborting address is also in the write-set of the aborted transaction, and as read-write otherwise.
+class ConflictProfiler {
+    static const uint64_t PAGE_SHIFT = 12;
+    static const uint64_t NUM_SHARDS = 64;
+    struct Allocation {
+        uint64_t    size;
+        uint64_t    skew;        // Bytes at the start of the block that are not visible to the user (the tmbase of tmMalloc())
+        const char* type;        // Mangled name of the type given to tmNew(), or nullptr for tmMalloc()
+    };
+    // Allocations indexed by their start address. Each allocation is in the shards of all the pages it overlaps.
+    struct alignas(128) Shard {
+        std::mutex                      mutex;
+        std::map<uintptr_t,Allocation>  allocs;
+    };
+    struct Hotspot {
+        uint64_t  aborts {0};
+        uint64_t  writeConflicts {0};
+        uint64_t  storesLost {0};   // Sum of the sizes of the write-sets of the aborted transactions
+        uintptr_t addr {0};         // Last sampled address
+    };
+    Shard shards[NUM_SHARDS];
+    std::mutex hotMutex;
+    // Keyed by {type, offset}, or by {"", address} for the addresses that were not allocated with tmNew()/tmMalloc()
+    std::map<std::pair<std::string,uint64_t>,Hotspot> hotspots;
+    const char* name;           // Of the STM, to tell apart the reports when more than one STM is linked
+
+    template<typename F> inline void forEachShard(uintptr_t start, uint64_t size, F&& func) {
+        const uintptr_t first = start >> PAGE_SHIFT;
+        const uintptr_t last = (start + std::max<uint64_t>(size,1) - 1) >> PAGE_SHIFT;
+        for (uintptr_t page = first; page <= last && page < first+NUM_SHARDS; page++) func(shards[page % NUM_SHARDS]);
+    }
 
-public:
-    HazardErasOF() {
-        he = new std::atomic<uint64_t>[REGISTRY_MAX_THREADS*CLPAD];
-        for (unsigned it = 0; it < REGISTRY_MAX_THREADS; it++) {
-            he[it*CLPAD].store(NOERA, std::memory_order_relaxed);
-            retiredList[it*CLPAD].reserve(REGISTRY_MAX_THREADS);  // We pre-reserve one object per thread, should be enough to start
-        }
+    static std::string demangle(const std::string& name) {
+        int status = 0;
+        char* dname = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+        if (dname == nullptr) return name;
+        std::string res {dname};
+        std::free(dname);
+        return res;
     }
 
-    ~HazardErasOF() {
-        // Clear the objects in the retired lists
-        for (unsigned it = 0; it < REGISTRY_MAX_THREADS; it++) {
-            for (unsigned iret = 0; iret < retiredList[it*CLPAD].size(); iret++) {
-                tmbase* del = retiredList[it*CLPAD][iret];
-                std::free(del);
-                // No need to call destructor because it was already executed as part of the transaction
-            }
-        }
-        delete[] he;
+    static void printRow(std::ostream& os, const Hotspot& h, const uint64_t total, const std::string& where) {
+        os << "  " << h.aborts << "\t" << (100*h.aborts)/total << "%\t" << (100*h.writeConflicts)/h.aborts << "%\t";
+        os << h.storesLost/h.aborts << "\t" << where << "\n";
     }
 
-    // Progress condition: wait-free population oblivious
-    inline void clear(const int tid) {
-        he[tid*CLPAD].store(NOERA, std::memory_order_release);
+public:
+    ConflictProfiler(const char* name) : name{name} { }
+
+    ~ConflictProfiler() {
+        if (TX_PROFILE) printReport(std::cerr);
     }
 
-    // Progress condition: wait-free population oblivious
-    inline void set(uint64_t trans, const int tid) {
-        he[tid*CLPAD].store(trans2seq(trans));
+    // Returns true if the current abort of the calling thread is one to be sampled
+    static inline bool sample() {
+        static thread_local uint64_t tl_aborts {0};
+        return (++tl_aborts % TX_PROFILE_PERIOD) == 0;
     }
 
-    // Progress condition: wait-free population oblivious
-    inline void addToRetiredList(tmbase* newdel, const int tid) {
-        retiredList[tid*CLPAD].push_back(newdel);
+    void onAlloc(const void* ptr, uint64_t size, uint64_t skew, const char* type) {
+        forEachShard((uintptr_t)ptr, size, [&] (Shard& shard) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.allocs[(uintptr_t)ptr] = {size, skew, type};
+        });
     }
 
-    /**
-     * Progress condition: bounded wait-free
-     *
-     * Attemps to delete the no-longer-in-use objects in the retired list.
-     * We need to pass the currEra coming from the seq of the currTx so that
-     * the objects from the current transaction don't get deleted.
-     *
-     * TODO: consider using erase() with std::remove_if()
-     */
-    void clean(uint64_t curEra, const int tid) {
-        if (retiredList[tid*CLPAD].size() < THRESHOLD_R) return;
-        for (unsigned iret = 0; iret < retiredList[tid*CLPAD].size();) {
-            tmbase* del = retiredList[tid*CLPAD][iret];
-            if (canDelete(curEra, del)) {
-                retiredList[tid*CLPAD].erase(retiredList[tid*CLPAD].begin() + iret);
-                std::free(del);
-                // No need to call destructor because it was executed as part of the transaction
-                continue;
-            }
-            iret++;
+    // Called for every block that goes back to the allocator, whether it was registered or not
+    void onFree(const void* ptr) {
+        Shard& shard = shards[((uintptr_t)ptr >> PAGE_SHIFT) % NUM_SHARDS];
+        uint64_t size;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.allocs.find((uintptr_t)ptr);
+            if (it == shard.allocs.end()) return;
+            size = it->second.size;
         }
+        forEachShard((uintptr_t)ptr, size, [&] (Shard& shard) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.allocs.erase((uintptr_t)ptr);
+        });
     }
 
-    // Progress condition: wait-free bounded (by the number of threads)
-    inline bool canDelete(uint64_t curEra, tmbase* del) {
-        // We can't delete objects from the current transaction
-        if (del->delEra_ == curEra) return false;
-        for (unsigned it = 0; it < ThreadRegistry::getMaxThreads(); it++) {
-            const auto era = he[it*CLPAD].load(std::memory_order_acquire);
-            if (era == NOERA || era < del->newEra_ || era > del->delEra_) continue;
-            return false;
+    void onAbort(const void* addr, uint64_t storesLost, bool writeConflict) {
+        const uintptr_t uaddr = (uintptr_t)addr;
+        std::pair<std::string,uint64_t> key {"", uaddr};
+        Shard& shard = shards[(uaddr >> PAGE_SHIFT) % NUM_SHARDS];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.allocs.upper_bound(uaddr);
+            if (it != shard.allocs.begin()) {
+                --it;
+                const Allocation& alloc = it->second;
+                if (uaddr < it->first + alloc.size) {
+                    if (alloc.type != nullptr) key.first = alloc.type;
+                    else key.first = "tmMalloc(" + std::to_string(alloc.size - alloc.skew) + ")";
+                    key.second = uaddr - it->first - alloc.skew;
+                }
+            }
         }
-        return true;
+        std::lock_guard<std::mutex> lock(hotMutex);
+        Hotspot& h = hotspots[key];
+        h.aborts++;
+        if (writeConflict) h.writeConflicts++;
+        h.storesLost += storesLost;
+        h.addr = uaddr;
+    }
+
+    // Prints the sampled aborts ranked by type, and then by address (type and offset), up to maxRows of each
+    void printReport(std::ostream& os, const uint64_t maxRows=20) {
+        std::lock_guard<std::mutex> lock(hotMutex);
+        if (hotspots.empty()) return;
+        uint64_t total = 0;
+        std::map<std::string,Hotspot> types;
+        for (auto& kv : hotspots) {
+            total += kv.second.aborts;
+            Hotspot& t = types[kv.first.first];
+            t.aborts += kv.second.aborts;
+            t.writeConflicts += kv.second.writeConflicts;
+            t.storesLost += kv.second.storesLost;
+        }
+        auto byAborts = [] (const auto* a, const auto* b) { return a->second.aborts > b->second.aborts; };
+        std::vector<const std::pair<const std::string,Hotspot>*> rtypes;
+        for (auto& kv : types) rtypes.push_back(&kv);
+        std::sort(rtypes.begin(), rtypes.end(), byAborts);
+        std::vector<const std::pair<const std::pair<std::string,uint64_t>,Hotspot>*> rspots;
+        for (auto& kv : hotspots) rspots.push_back(&kv);
+        std::sort(rspots.begin(), rspots.end(), byAborts);
+        os << "\nConflictProfiler " << name << ": " << total << " sampled aborts (1 in " << TX_PROFILE_PERIOD << ")\n";
+        os << "  aborts\t%\twrite-write\tstores/abort\ttype\n";
+        for (uint64_t i = 0; i < rtypes.size() && i < maxRows; i++) {
+            const std::string& type = rtypes[i]->first;
+            printRow(os, rtypes[i]->second, total, type.empty() ? "(not allocated with tmNew/tmMalloc)" : demangle(type));
+        }
+        os << "  aborts\t%\twrite-write\tstores/abort\taddress\n";
+        for (uint64_t i = 0; i < rspots.size() && i < maxRows; i++) {
+            const auto& key = rspots[i]->first;
+            std::stringstream where;
+            if (key.first.empty()) where << (void*)key.second << " (not allocated with tmNew/tmMalloc)";
+            else where << demangle(key.first) << " +" << key.second << "  (last at " << (void*)rspots[i]->second.addr << ")";
+            printRow(os, rspots[i]->second, total, where.str());
+        }
+    }
+
+    // Discards the samples, to profile each benchmark on its own
+    void clear() {
+        std::lock_guard<std::mutex> lock(hotMutex);
+        hotspots.clear();
     }
 };
 
 
+
 // We need to split the contents from the methods due to compilation dependencies
 template<typename T> struct tmtypebase {
     // Stores the actual value as an atomic
     alignas(16) std::atomic<uint64_t>  val;
     // Lets hope this comes immediately after 'val' in memory mapping, otherwise the DCAS() will fail
     alignas(8)  std::atomic<uint64_t>  seq {1};
+
+    // Used only internally by the commit combining mode, for operations[] and results[]
+    inline uint64_t getSeq() const {
+        return seq.load(std::memory_order_acquire);
+    }
+
+    // Used only internally by the commit combining mode.
+    // Returns true if the 'val' and 'seq' placed in 'keepVal' and 'keepSeq' are consistent.
+    inline bool rawLoad(uint64_t& keepVal, uint64_t& keepSeq) const {
+        keepSeq = seq.load(std::memory_order_acquire);
+        keepVal = val.load(std::memory_order_acquire);
+        return (keepSeq == seq.load(std::memory_order_acquire));
+    }
+
+    // Used only internally by the commit combining mode
+    inline void rawStore(uint64_t newVal, uint64_t lseq) {
+        val.store(newVal, std::memory_order_relaxed);
+        seq.store(lseq, std::memory_order_release);
+    }
 };
 
 
@@ -265,522 +352,1905 @@ template<typename T> struct tmtypebase {
 struct WriteSetEntry {
     void*          addr {nullptr};  // Address of value+sequence to change
     uint64_t       val;             // Desired value to change to
-    WriteSetEntry* next {nullptr};  // Pointer to next node in the (intrusive) hash map
 };
 
-extern thread_local bool tl_is_read_only;
 
+// Transaction statistics, summed over all threads by getTxStats(). They are collected only when TX_STATS is
+// true, otherwise all the counters are zero. Subtract two snapshots to get the statistics of an interval.
+struct TxStats {
+    static const bool enabled = TX_STATS;
+    static const int  WS_BUCKETS = 16;    // Bucket i>0 of wsHistogram counts write-sets of 2^(i-1) to 2^i-1 stores
+    uint64_t commits {0};                 // Committed transactions, including read-only ones
+    uint64_t abortsLoad {0};              // Aborts because a load saw a sequence newer than the transaction
+    uint64_t abortsCommit {0};            // Aborts because curTx changed before the commit, or the CAS on curTx failed
+    uint64_t abortsBegin {0};             // Restarts of a transaction because curTx changed while it was starting
+    uint64_t helps {0};                   // Calls to helpApply() that applied the write-set of another thread
+    uint64_t helpBytes {0};               // Bytes of write-set entries copied from other threads by helpApply()
+    uint64_t allocs {0};                  // Objects allocated by committed transactions
+    uint64_t retires {0};                 // Objects retired by committed transactions
+    uint64_t wsHistogram[WS_BUCKETS] {};  // Committed transactions for each size of the write-set
+    uint64_t retiredListLength {0};       // Objects waiting in the retired lists of Hazard Eras
+
+    TxStats operator-(const TxStats& other) const {
+        TxStats st {*this};
+        st.commits -= other.commits;
+        st.abortsLoad -= other.abortsLoad;
+        st.abortsCommit -= other.abortsCommit;
+        st.abortsBegin -= other.abortsBegin;
+        st.helps -= other.helps;
+        st.helpBytes -= other.helpBytes;
+        st.allocs -= other.allocs;
+        st.retires -= other.retires;
+        for (int i = 0; i < WS_BUCKETS; i++) st.wsHistogram[i] -= other.wsHistogram[i];
+        return st;
+    }
+};
 
-// The write-set is a log of the words modified during the transaction.
-// This log is an array with an intrusive hashmap of size HASH_BUCKETS.
-struct WriteSet {
-    static const uint64_t MAX_ARRAY_LOOKUP = 30;  // Beyond this, it seems to be faster to use the hashmap
-    WriteSetEntry*        buckets[HASH_BUCKETS];  // Intrusive HashMap for fast lookup in large(r) transactions
-    uint64_t              numStores {0};          // Number of stores in the writeSet for the current transaction
-    WriteSetEntry         log[TX_MAX_STORES];     // Redo log of stores
 
-    WriteSet() {
-        numStores = 0;
-        for (unsigned i = 0; i < HASH_BUCKETS; i++) buckets[i] = &log[TX_MAX_STORES-1];
+// Counters of the TxStats of one thread, written only by the owner thread.
+// TxCounters<false> is empty and all its methods do nothing, which is how the statistics are compiled out.
+template<bool enabled> struct TxCounters {
+    std::atomic<uint64_t> commits {0};
+    std::atomic<uint64_t> abortsLoad {0};
+    std::atomic<uint64_t> abortsCommit {0};
+    std::atomic<uint64_t> abortsBegin {0};
+    std::atomic<uint64_t> helps {0};
+    std::atomic<uint64_t> helpBytes {0};
+    std::atomic<uint64_t> allocs {0};
+    std::atomic<uint64_t> retires {0};
+    std::atomic<uint64_t> wsHistogram[TxStats::WS_BUCKETS] {};
+
+    static inline void inc(std::atomic<uint64_t>& counter, uint64_t n=1) {
+        counter.store(counter.load(std::memory_order_relaxed)+n, std::memory_order_relaxed);
     }
+    inline void onCommit(uint64_t numStores, uint64_t numAllocs, uint64_t numRetires) {
+        inc(commits);
+        inc(allocs, numAllocs);
+        inc(retires, numRetires);
+        inc(wsHistogram[numStores == 0 ? 0 : std::min(64-__builtin_clzll(numStores), TxStats::WS_BUCKETS-1)]);
+    }
+    inline void onAbortLoad() { inc(abortsLoad); }
+    inline void onAbortCommit() { inc(abortsCommit); }
+    inline void onAbortBegin() { inc(abortsBegin); }
+    inline void onHelp(uint64_t bytes) { inc(helps); inc(helpBytes, bytes); }
+    inline void onAlloc() { inc(allocs); }
+    inline void onRetire() { inc(retires); }
+
+    void addTo(TxStats& st) const {
+        st.commits += commits.load(std::memory_order_relaxed);
+        st.abortsLoad += abortsLoad.load(std::memory_order_relaxed);
+        st.abortsCommit += abortsCommit.load(std::memory_order_relaxed);
+        st.abortsBegin += abortsBegin.load(std::memory_order_relaxed);
+        st.helps += helps.load(std::memory_order_relaxed);
+        st.helpBytes += helpBytes.load(std::memory_order_relaxed);
+        st.allocs += allocs.load(std::memory_order_relaxed);
+        st.retires += retires.load(std::memory_order_relaxed);
+        for (int i = 0; i < TxStats::WS_BUCKETS; i++) st.wsHistogram[i] += wsHistogram[i].load(std::memory_order_relaxed);
+    }
+};
 
-    // Each address on a different bucket
-    inline uint64_t hash(const void* addr) const {
-        return (((uint64_t)addr) >> 3) % HASH_BUCKETS;
+template<> struct TxCounters<false> {
+    inline void onCommit(uint64_t, uint64_t, uint64_t) { }
+    inline void onAbortLoad() { }
+    inline void onAbortCommit() { }
+    inline void onAbortBegin() { }
+    inline void onHelp(uint64_t) { }
+    inline void onAlloc() { }
+    inline void onRetire() { }
+    void addTo(TxStats&) const { }
+};
+
+
+// Used to identify aborted transactions
+struct AbortedTx {};
+static constexpr AbortedTx AbortedTxException {};
+
+
+// The engine with the configuration 'Config' (see DefaultConfig). Each configuration has its own instance of OneFileLF,
+// thread registry and thread-local data, therefore, engines with different configurations can be used in the same
+// program, but a transaction of one engine can't access the tmtypes of another. The names in namespace oflf, like
+// oflf::OneFileLF and oflf::tmtype, are those of Engine<DefaultConfig>.
+template<typename Config> struct Engine {
+    // Maximum number of registered threads that can execute transactions. Compile with -DREGISTRY_CAPACITY=N to change it.
+    static constexpr int REGISTRY_MAX_THREADS = Config::registryThreads;
+    // Number of stores in each chunk of the WriteSet. The WriteSet grows one chunk at a time, without limit.
+    static constexpr uint64_t TX_CHUNK_STORES = Config::chunkStores;
+    // Number of chunks the WriteSet keeps between transactions. Chunks beyond these are released after a large transaction.
+    static constexpr uint64_t TX_KEEP_CHUNKS = Config::keepChunks;
+    // Initial number of slots in the index of the WriteSet. The index doubles whenever it gets half full.
+    static constexpr uint64_t TX_INDEX_SLOTS = Config::indexSlots;
+    // Number of stores up to which lookups in the WriteSet scan the log, instead of using the index. The index is only
+    // built once the log gets larger than this, which saves its upkeep in small transactions. Zero always uses the index.
+    static constexpr uint64_t TX_LINEAR_STORES = Config::linearStores;
+    // Number of the most recent allocations of a transaction whose stores skip the WriteSet (see OpData::isCaptured()).
+    // Zero disables it.
+    static constexpr uint64_t TX_CAPTURE_ALLOCS = Config::captureAllocs;
+    // Largest allocation (in bytes) of tmNew()/tmMalloc() that is recycled through the per-thread cache (see AllocCache)
+    static constexpr uint64_t TX_CACHE_MAX_SIZE = Config::cacheMaxSize;
+    // Maximum number of free blocks each thread keeps for each size class. Zero disables the cache.
+    static constexpr uint64_t TX_CACHE_BLOCKS = Config::cacheBlocks;
+
+    // Number of bits of a transaction identifier that hold the index of the thread, the other bits hold the sequence.
+    // The default REGISTRY_MAX_THREADS fits in 10 bits, larger registries get 16 bits.
+    static constexpr uint64_t TX_IDX_BITS = (REGISTRY_MAX_THREADS <= 1024) ? 10 : 16;
+    static_assert(REGISTRY_MAX_THREADS <= (1 << 16), "REGISTRY_MAX_THREADS doesn't fit in the index of a transaction identifier");
+
+    // Functions to convert between a transaction identifier (uint64_t) and a pair of {sequence,index}
+    static inline uint64_t seqidx2trans(uint64_t seq, uint64_t idx) {
+        return (seq << TX_IDX_BITS) | idx;
+    }
+    static inline uint64_t trans2seq(uint64_t trans) {
+        return trans >> TX_IDX_BITS;
     }
+    static inline uint64_t trans2idx(uint64_t trans) {
+        return trans & ((1ULL << TX_IDX_BITS)-1);
+    }
+
+
+    //
+    // Thread Registry stuff
+    //
+    static void thread_registry_deregister_thread(const int tid);
+
+    // An helper class to do the checkin and checkout of the thread registry
+    struct ThreadCheckInCheckOut {
+        static const int NOT_ASSIGNED = -1;
+        int tid { NOT_ASSIGNED };
+        ~ThreadCheckInCheckOut() {
+            if (tid == NOT_ASSIGNED) return;
+            thread_registry_deregister_thread(tid);
+        }
+    };
+
+    static thread_local ThreadCheckInCheckOut tl_tcico;
+
+    // Global/singleton instance, defined in Globals
+    class ThreadRegistry;
+    static ThreadRegistry& gThreadRegistry;
+
+    /*
+     * <h1> Registry for threads </h1>
+     *
+     * This is singleton type class that allows assignement of a unique id to each thread.
+     * The first time a thread calls ThreadRegistry::getTID() it will get the lowest free tid from 'tids' (see ThreadRegistryBitmap).
+     * This tid wil be saved in a thread-local variable of the type ThreadCheckInCheckOut which
+     * upon destruction of the thread will call the destructor of ThreadCheckInCheckOut and free the
+     * corresponding slot to be used by a later thread.
+     * The bitmap is shared with common/ThreadRegistry.hpp, so getMaxThreads() shrinks when threads exit and
+     * getUsedTIDs() lets scans skip the free tids.
+     */
+    class ThreadRegistry {
+    private:
+        ThreadRegistryBitmap<REGISTRY_MAX_THREADS> tids;
+
+    public:
+        // Progress condition: wait-free bounded (by the number of threads) to get the tid, lock-free to update maxTid
+        int register_thread_new(void) {
+            const int tid = tids.acquire();
+            if (tid == ThreadRegistryBitmap<REGISTRY_MAX_THREADS>::NO_TID) {
+                std::cout << "ERROR: Too many threads, registry can only hold " << REGISTRY_MAX_THREADS << " threads\n";
+                assert(false);
+            }
+            tl_tcico.tid = tid;
+            return tid;
+        }
+
+        // Progress condition: lock-free
+        inline void deregister_thread(const int tid) {
+            tids.release(tid);
+        }
+
+        // Progress condition: wait-free population oblivious
+        static inline uint64_t getMaxThreads(void) {
+            return gThreadRegistry.tids.getMaxThreads();
+        }
+
+        // Progress condition: wait-free population oblivious
+        // See ThreadRegistryBitmap::getUsedTIDs()
+        static inline uint64_t getUsedTIDs(const int w) {
+            return gThreadRegistry.tids.getUsedTIDs(w);
+        }
+
+        // Progress condition: wait-free bounded (by the number of threads)
+        static inline int getTID(void) {
+            int tid = tl_tcico.tid;
+            if (tid != ThreadCheckInCheckOut::NOT_ASSIGNED) return tid;
+            return gThreadRegistry.register_thread_new();
+        }
+    };
+
+
+    // Defined in Globals, at the end of the engine
+    static ConflictProfiler& gConflictProfiler;
+
+
+    // Per-thread cache of the memory blocks used by tmNew() and tmMalloc(), with one free list for each size class
+    // (multiples of 16 bytes). Each block starts with a small header holding its size class, so that it can be
+    // recycled without knowing the type of the object, be it by Hazard Eras, by the rollback of an aborted
+    // transaction, or by tmDelete()/tmFree() outside of a transaction.
+    // A block goes to the cache of the thread that frees it, which means that a transaction that aborts gets its
+    // allocations back when it is retried, and that the nodes a thread retires are reused by its next inserts.
+    // Blocks larger than TX_CACHE_MAX_SIZE, or beyond TX_CACHE_BLOCKS in a free list, go back to std::free().
+    // There is no constructor nor destructor so that the thread_local tl_cache can be used at any time, even while
+    // the thread is exiting. The thread flushes its cache when it de-registers.
+    struct AllocCache {
+        static const uint64_t NUM_CLASSES = TX_CACHE_MAX_SIZE/16 + 1;
+        struct Block {
+            uint64_t sizeClass;      // Size of the block in multiples of 16 bytes
+            Block*   next;           // Next block in the free list
+        };
+        static const uint64_t HEADER = sizeof(Block);  // Keeps the 16 bytes alignment of std::malloc()
+        Block*   lists[NUM_CLASSES];
+        uint64_t counts[NUM_CLASSES];
+
+        inline void* allocate(uint64_t size) {
+            const uint64_t sc = (size+15)/16;
+            Block* block = (sc < NUM_CLASSES) ? lists[sc] : nullptr;
+            if (block != nullptr) {
+                lists[sc] = block->next;
+                counts[sc]--;
+            } else {
+                block = (Block*)std::malloc(HEADER + sc*16);
+                if (block == nullptr) throw std::bad_alloc();
+                block->sizeClass = sc;
+            }
+            return (uint8_t*)block + HEADER;
+        }
+
+        inline void deallocate(void* ptr) {
+            if (TX_PROFILE) gConflictProfiler.onFree(ptr);
+            Block* block = (Block*)((uint8_t*)ptr - HEADER);
+            const uint64_t sc = block->sizeClass;
+            if (sc >= NUM_CLASSES || counts[sc] >= TX_CACHE_BLOCKS) {
+                std::free(block);
+                return;
+            }
+            block->next = lists[sc];
+            lists[sc] = block;
+            counts[sc]++;
+        }
+
+        // Frees a block without going through the cache of the current thread
+        static inline void release(void* ptr) {
+            if (TX_PROFILE) gConflictProfiler.onFree(ptr);
+            std::free((uint8_t*)ptr - HEADER);
+        }
+
+        // Returns all the free blocks to std::free()
+        void flush() {
+            for (uint64_t sc = 0; sc < NUM_CLASSES; sc++) {
+                while (lists[sc] != nullptr) {
+                    Block* block = lists[sc];
+                    lists[sc] = block->next;
+                    std::free(block);
+                }
+                counts[sc] = 0;
+            }
+        }
+    };
+
+    static thread_local AllocCache tl_cache;
+
+
+    // This is a specialized implementation of Hazard Eras meant to be used in the OneFile STM.
+    // Hazard Eras is a lock-free memory reclamation technique described here:
+    // https://github.com/pramalhe/ConcurrencyFreaks/blob/master/papers/hazarderas-2017.pdf
+    // https://dl.acm.org/citation.cfm?id=3087588
+    //
+    // We're using OneFileLF::curTx.seq as the global era.
+    class HazardErasOF {
+    private:
+        static const uint64_t                    NOERA = 0;
+        static const int                         CLPAD = 128/sizeof(std::atomic<uint64_t>);
+        alignas(128) std::atomic<uint64_t>*      he;
+        // Reclamation state of each thread. The counters are written by the owner thread and read by getStats()
+        struct alignas(128) ReclaimState {
+            uint64_t              nextScan {TX_RECLAIM_THRESHOLD}; // Scan the retired list when it reaches this size
+            std::vector<uint64_t> eras;                            // Sorted snapshot of the published eras
+            std::atomic<uint64_t> retired {0};
+            std::atomic<uint64_t> scans {0};
+            std::atomic<uint64_t> freed {0};
+            std::atomic<uint64_t> eraLag {0};
+            std::atomic<uint64_t> scanNanos {0};
+        };
+        ReclaimState                             rstate[REGISTRY_MAX_THREADS];
+        // It's not nice that we have a lot of empty vectors, but we need padding to avoid false sharing
+        alignas(128) std::vector<tmbase*>        retiredList[REGISTRY_MAX_THREADS*CLPAD];
+
+    public:
+        // Counters of Hazard Eras, summed over all threads by getStats()
+        struct Stats {
+            uint64_t retired {0};    // Objects in the retired lists, waiting to be freed
+            uint64_t scans {0};      // Number of scans of the retired lists
+            uint64_t freed {0};      // Number of objects freed
+            uint64_t eraLag {0};     // Sum over the freed objects of the number of transactions between their retire and their free
+            uint64_t scanNanos {0};  // Time spent in the scans of the retired lists
+        };
+
+        HazardErasOF() {
+            he = new std::atomic<uint64_t>[REGISTRY_MAX_THREADS*CLPAD];
+            for (unsigned it = 0; it < REGISTRY_MAX_THREADS; it++) {
+                he[it*CLPAD].store(NOERA, std::memory_order_relaxed);
+                retiredList[it*CLPAD].reserve(REGISTRY_MAX_THREADS);  // We pre-reserve one object per thread, should be enough to start
+            }
+        }
+
+        ~HazardErasOF() {
+            // Clear the objects in the retired lists
+            for (unsigned it = 0; it < REGISTRY_MAX_THREADS; it++) {
+                for (unsigned iret = 0; iret < retiredList[it*CLPAD].size(); iret++) {
+                    tmbase* del = retiredList[it*CLPAD][iret];
+                    AllocCache::release(del);
+                    // No need to call destructor because it was already executed as part of the transaction
+                }
+            }
+            delete[] he;
+        }
+
+        // Progress condition: wait-free population oblivious
+        inline void clear(const int tid) {
+            he[tid*CLPAD].store(NOERA, std::memory_order_release);
+        }
+
+        // Progress condition: wait-free population oblivious
+        inline void set(uint64_t trans, const int tid) {
+            he[tid*CLPAD].store(trans2seq(trans));
+        }
+
+        // Progress condition: wait-free population oblivious
+        inline void addToRetiredList(tmbase* newdel, const int tid) {
+            retiredList[tid*CLPAD].push_back(newdel);
+        }
+
+        /**
+         * Progress condition: bounded wait-free
+         *
+         * Attemps to delete the no-longer-in-use objects in the retired list.
+         * We need to pass the currEra coming from the seq of the currTx so that
+         * the objects from the current transaction don't get deleted.
+         *
+         * The scan is done only after TX_RECLAIM_THRESHOLD objects have been retired since the previous one.
+         * All the objects in the list were retired before we read the published eras, therefore, a single
+         * (sorted) snapshot of the eras is enough to check all of them.
+         */
+        void clean(uint64_t curEra, const int tid) {
+            ReclaimState& rs = rstate[tid];
+            const uint64_t size = retiredList[tid*CLPAD].size();
+            if (size < rs.nextScan) {
+                rs.retired.store(size, std::memory_order_relaxed);
+                return;
+            }
+            const auto startBeats = std::chrono::steady_clock::now();
+            rs.eras.clear();
+            // Only the threads in use can have a published era
+            const uint64_t maxThreads = ThreadRegistry::getMaxThreads();
+            for (unsigned w = 0; w*64 < maxThreads; w++) {
+                for (uint64_t used = ThreadRegistry::getUsedTIDs(w); used != 0; used &= used-1) {
+                    const unsigned it = w*64 + __builtin_ctzll(used);
+                    const auto era = he[it*CLPAD].load(std::memory_order_acquire);
+                    if (era != NOERA) rs.eras.push_back(era);
+                }
+            }
+            std::sort(rs.eras.begin(), rs.eras.end());
+            uint64_t freed = 0, eraLag = 0;
+            cleanList(retiredList[tid*CLPAD], curEra, rs.eras, freed, eraLag, [] (tmbase* del) { tl_cache.deallocate(del); });  // The destructor was executed in the transaction
+            const uint64_t left = size - freed;
+            rs.nextScan = left + TX_RECLAIM_THRESHOLD;
+            const auto stopBeats = std::chrono::steady_clock::now();
+            rs.retired.store(left, std::memory_order_relaxed);
+            rs.scans.store(rs.scans.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+            rs.freed.store(rs.freed.load(std::memory_order_relaxed)+freed, std::memory_order_relaxed);
+            rs.eraLag.store(rs.eraLag.load(std::memory_order_relaxed)+eraLag, std::memory_order_relaxed);
+            const uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(stopBeats-startBeats).count();
+            rs.scanNanos.store(rs.scanNanos.load(std::memory_order_relaxed)+nanos, std::memory_order_relaxed);
+        }
+
+        // Progress condition: wait-free bounded (by the number of threads)
+        // Returns the sum of the counters of all threads. Meant for statistics, it's not an atomic snapshot.
+        Stats getStats() const {
+            Stats st {};
+            for (unsigned it = 0; it < REGISTRY_MAX_THREADS; it++) {
+                st.retired += rstate[it].retired.load(std::memory_order_relaxed);
+                st.scans += rstate[it].scans.load(std::memory_order_relaxed);
+                st.freed += rstate[it].freed.load(std::memory_order_relaxed);
+                st.eraLag += rstate[it].eraLag.load(std::memory_order_relaxed);
+                st.scanNanos += rstate[it].scanNanos.load(std::memory_order_relaxed);
+            }
+            return st;
+        }
+
+    private:
+        // Frees the objects of 'list' that are not protected by any of the 'eras', and compacts the list in a single pass
+        template<typename O, typename D> void cleanList(std::vector<O*>& list, uint64_t curEra, const std::vector<uint64_t>& eras,
+                                                        uint64_t& freed, uint64_t& eraLag, D reclaim) {
+            uint64_t keep = 0;
+            for (uint64_t iret = 0; iret < list.size(); iret++) {
+                O* del = list[iret];
+                if (canDelete(curEra, del, eras)) {
+                    eraLag += curEra - std::min(curEra, del->delEra_);
+                    freed++;
+                    reclaim(del);
+                } else {
+                    list[keep++] = del;
+                }
+            }
+            list.resize(keep);
+        }
+
+        // Progress condition: wait-free bounded (logarithmic on the number of threads)
+        // The object is protected if a published era is in [newEra_,delEra_], i.e. if the first era not
+        // lower than newEra_ is also not higher than delEra_.
+        inline bool canDelete(uint64_t curEra, tmbase* del, const std::vector<uint64_t>& eras) {
+            // We can't delete objects from the current transaction
+            if (del->delEra_ == curEra) return false;
+            const auto era = std::lower_bound(eras.begin(), eras.end(), del->newEra_);
+            return era == eras.end() || *era > del->delEra_;
+        }
+    };
+
+
+    // A chunk of the redo log. Chunks are linked so that other threads can walk (and copy) the log of the owner.
+    // They are tracked with Hazard Eras because a helper may be copying a chunk while the owner releases it.
+    struct WriteSetChunk : public tmbase {
+        std::atomic<WriteSetChunk*> next {nullptr};
+        WriteSetEntry               log[TX_CHUNK_STORES];
+    };
+
+    static thread_local bool tl_is_read_only;
+
+
+    // The write-set is a log of the words modified during the transaction.
+    // This log is a list of chunks with an open-addressing index of the addresses, to find them in the log.
+    // Only the owner thread modifies a WriteSet. Other threads can make a copy of it in helpApply(),
+    // in which case they walk the linked chunks instead of 'chunks', because 'chunks' may be re-allocated at any time.
+    struct WriteSet {
+        static const uint64_t      INDEX_GROUP = 8;        // Number of tags compared at once when probing the index
+        static const uint64_t      FILTER_SHIFT = 9;       // The bloom filter has 2^FILTER_SHIFT bits
+        static const uint64_t      FILTER_BITS = 1ULL << FILTER_SHIFT;
+        static const uint64_t      NO_ENTRY = ~0ULL;
+        static const uintptr_t     DELTA = 1;              // Tag of the addr of the entries with the deltas of a tmcounter
+        std::vector<uint32_t>      idxTags;                // Open-addressing index of the log: tag of the addr in each slot, zero if empty
+        std::vector<uint32_t>      idxEntries;             // Position in the log of the entry in each slot of the index
+        std::vector<uint32_t>      idxUsed;                // Slots taken in the current transaction, so that resetting the index is O(stores)
+        uint64_t                   filter[FILTER_BITS/64]; // Bloom filter of the addresses in the log, reset on the first store
+        uint64_t                   numStores {0};          // Number of stores in the writeSet for the current transaction
+        uint64_t                   numDeltas {0};          // Number of entries with the deltas of a tmcounter, reset on the first store
+        std::vector<WriteSetChunk*> chunks;                // Direct access to the chunks of the log (owner thread only)
+        WriteSetChunk              first;                  // The first chunk of the redo log is never released
+
+        static_assert((TX_INDEX_SLOTS & (TX_INDEX_SLOTS-1)) == 0 && TX_INDEX_SLOTS >= INDEX_GROUP, "TX_INDEX_SLOTS must be a power of two");
+        static_assert((TX_CHUNK_STORES & (TX_CHUNK_STORES-1)) == 0, "TX_CHUNK_STORES must be a power of two");
+        static_assert(TX_CHUNK_STORES % TX_APPLY_STORES == 0, "TX_APPLY_STORES must be a divisor of TX_CHUNK_STORES");
+
+        WriteSet() {
+            numStores = 0;
+            idxTags.resize(TX_INDEX_SLOTS, 0);
+            idxEntries.resize(TX_INDEX_SLOTS);
+            chunks.reserve(TX_KEEP_CHUNKS);
+            chunks.push_back(&first);
+        }
+
+        ~WriteSet() {
+            for (uint64_t i = 1; i < chunks.size(); i++) AllocCache::release(chunks[i]);
+        }
+
+        // Returns the idx-th entry of the log
+        inline WriteSetEntry& entry(uint64_t idx) {
+            return chunks[idx / TX_CHUNK_STORES]->log[idx % TX_CHUNK_STORES];
+        }
 
-    // Adds a modification to the redo log
-    inline void addOrReplace(void* addr, uint64_t val) {
-        if (tl_is_read_only) tl_is_read_only = false;
-        const uint64_t hashAddr = hash(addr);
-        if (numStores < MAX_ARRAY_LOOKUP) {
-            // Lookup in array
-            for (unsigned int idx = 0; idx < numStores; idx++) {
-                if (log[idx].addr == addr) {
-                    log[idx].val = val;
+        // Makes sure there is room in the log for 'size' entries, allocating new chunks if needed
+        inline void reserve(uint64_t size) {
+            while (chunks.size()*TX_CHUNK_STORES < size) {
+                WriteSetChunk* chunk = (WriteSetChunk*)tl_cache.allocate(sizeof(WriteSetChunk));
+                new (chunk) WriteSetChunk();
+                chunks.back()->next.store(chunk, std::memory_order_release);
+                chunks.push_back(chunk);
+            }
+        }
+
+        // Releases the chunks beyond TX_KEEP_CHUNKS, if any. Must be called with an empty log.
+        // Other threads may still be walking these chunks, therefore, we retire them with Hazard Eras.
+        // We leave newEra_ at zero because the chunks were reachable since before any era a helper may have published,
+        // and we read the era for delEra_ only after unlinking them.
+        inline void shrink(HazardErasOF& he, const std::atomic<uint64_t>& curTx, const int tid) {
+            if (chunks.size() <= TX_KEEP_CHUNKS) return;
+            chunks[TX_KEEP_CHUNKS-1]->next.store(nullptr);
+            const uint64_t curEra = trans2seq(curTx.load());
+            for (uint64_t i = TX_KEEP_CHUNKS; i < chunks.size(); i++) {
+                chunks[i]->delEra_ = curEra;
+                he.addToRetiredList(chunks[i], tid);
+            }
+            chunks.resize(TX_KEEP_CHUNKS);
+            // The index is owned by this thread, no need for Hazard Eras
+            if (idxTags.size() > 2*TX_KEEP_CHUNKS*TX_CHUNK_STORES) {
+                idxTags.assign(TX_INDEX_SLOTS, 0);
+                idxTags.shrink_to_fit();
+                idxEntries.resize(TX_INDEX_SLOTS);
+                idxEntries.shrink_to_fit();
+                idxUsed.clear();
+                idxUsed.shrink_to_fit();
+            }
+        }
+
+        // Multiplicative hash of an addr (tmtypes are 16 bytes aligned). The bloom filter takes its two bits
+        // from the top of the hash, the index takes the first slot to probe from the middle and the tag from the bottom.
+        static inline uint64_t hash(const void* addr) {
+            return ((uint64_t)addr >> 4) * 0x9E3779B97F4A7C15ULL;
+        }
+
+        // Returns false if the addr with hash 'h' is surely not in the log, which is what happens for most loads
+        inline bool filterMayContain(const uint64_t h) const {
+            const uint64_t b1 = h >> (64-FILTER_SHIFT);
+            const uint64_t b2 = (h >> (64-2*FILTER_SHIFT)) & (FILTER_BITS-1);
+            return (filter[b1/64] & (1ULL << (b1%64))) && (filter[b2/64] & (1ULL << (b2%64)));
+        }
+
+        inline void filterAdd(const uint64_t h) {
+            const uint64_t b1 = h >> (64-FILTER_SHIFT);
+            const uint64_t b2 = (h >> (64-2*FILTER_SHIFT)) & (FILTER_BITS-1);
+            filter[b1/64] |= 1ULL << (b1%64);
+            filter[b2/64] |= 1ULL << (b2%64);
+        }
+
+        // Returns a bitmask of the slots in 'group' (INDEX_GROUP consecutive slots of the index) whose tag is 'tag'.
+        // The tags of the group are compared all at once with SIMD instructions.
+        static inline uint32_t matchGroup(const uint32_t* group, const uint32_t tag) {
+#if defined(__AVX2__)
+            const __m256i cmp = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)group), _mm256_set1_epi32(tag));
+            return _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+#elif defined(__SSE2__)
+            const __m128i vtag = _mm_set1_epi32(tag);
+            const __m128i lo = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)group), vtag);
+            const __m128i hi = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(group+4)), vtag);
+            return _mm_movemask_ps(_mm_castsi128_ps(lo)) | (_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4);
+#else
+            uint32_t mask = 0;
+            for (uint64_t i = 0; i < INDEX_GROUP; i++) if (group[i] == tag) mask |= 1U << i;
+            return mask;
+#endif
+        }
+
+        // Returns the position in the log of the entry for 'addr', or NO_ENTRY if it's not in the log.
+        // Up to TX_LINEAR_STORES entries, we scan the log, otherwise, we probe one group of slots after the other,
+        // until we find the addr or a group with an empty slot.
+        // Slots taken by previous transactions may still be in the index if there were no stores yet, hence the check on numStores.
+        inline uint64_t indexFind(const void* addr, const uint64_t h) {
+            if (TX_LINEAR_STORES != 0 && numStores <= TX_LINEAR_STORES) {
+                for (uint64_t i = 0; i < numStores; i++) if (entry(i).addr == addr) return i;
+                return NO_ENTRY;
+            }
+            const uint32_t tag = (uint32_t)h | 1;
+            const uint64_t mask = idxTags.size()-1;
+            for (uint64_t g = (h >> 32) & mask & ~(INDEX_GROUP-1);; g = (g + INDEX_GROUP) & mask) {
+                for (uint32_t m = matchGroup(&idxTags[g], tag); m != 0; m &= m-1) {
+                    const uint64_t eidx = idxEntries[g + __builtin_ctz(m)];
+                    if (eidx < numStores && entry(eidx).addr == addr) return eidx;
+                }
+                if (matchGroup(&idxTags[g], 0) != 0) return NO_ENTRY;
+            }
+        }
+
+        // Adds the entry at position 'eidx' of the log to the index, in the first empty slot
+        inline void indexInsert(const uint64_t h, const uint64_t eidx) {
+            const uint64_t mask = idxTags.size()-1;
+            for (uint64_t g = (h >> 32) & mask & ~(INDEX_GROUP-1);; g = (g + INDEX_GROUP) & mask) {
+                const uint32_t m = matchGroup(&idxTags[g], 0);
+                if (m == 0) continue;
+                const uint64_t slot = g + __builtin_ctz(m);
+                idxTags[slot] = (uint32_t)h | 1;
+                idxEntries[slot] = eidx;
+                idxUsed.push_back(slot);
+                return;
+            }
+        }
+
+        // Empties the index, touching only the slots taken since the last time it was emptied
+        inline void indexClear() {
+            for (uint32_t slot : idxUsed) idxTags[slot] = 0;
+            idxUsed.clear();
+        }
+
+        // Doubles the number of slots in the index until it has room for one more entry, and adds again all the entries of the log
+        inline void indexGrow() {
+            indexClear();
+            uint64_t slots = idxTags.size();
+            while (2*(numStores+1) > slots) slots *= 2;
+            idxTags.resize(slots, 0);
+            idxEntries.resize(slots);
+            for (uint64_t i = 0; i < numStores; i++) indexInsert(hash(entry(i).addr), i);
+        }
+
+        // Adds a modification to the redo log
+        inline void addOrReplace(void* addr, uint64_t val) {
+            if (tl_is_read_only) tl_is_read_only = false;
+            // The log may have been reset since the last store, and so must the bloom filter and the index
+            if (numStores == 0) {
+                std::memset(filter, 0, sizeof(filter));
+                numDeltas = 0;
+                indexClear();
+            }
+            const uint64_t h = hash(addr);
+            // Skip the lookup if the bloom filter says the addr is not in the log
+            if (filterMayContain(h)) {
+                const uint64_t eidx = indexFind(addr, h);
+                if (eidx != NO_ENTRY) {
+                    entry(eidx).val = val;
                     return;
                 }
             }
-        } else {
-            // Lookup in hashmap
-            WriteSetEntry* be = buckets[hash(addr)];
-            if (be < &log[numStores]) {
-                while (be != nullptr) {
-                    if (be->addr == addr) {
-                        be->val = val;
+            // Add to the log and to the index, which we keep at most half full. The index starts with the entry after
+            // the first TX_LINEAR_STORES, and gets those in indexGrow().
+            filterAdd(h);
+            const uint64_t eidx = numStores;
+            if (eidx >= TX_LINEAR_STORES) {
+                if ((TX_LINEAR_STORES != 0 && eidx == TX_LINEAR_STORES) || 2*(idxUsed.size()+1) > idxTags.size()) indexGrow();
+                indexInsert(h, eidx);
+            }
+            reserve(numStores+1);
+            numStores++;
+            WriteSetEntry& e = entry(eidx);
+            e.addr = addr;
+            e.val = val;
+        }
+
+        // Does a lookup on the WriteSet for an addr.
+        // If the bloom filter says the addr is not in the log, there is nothing else to do, otherwise, the lookup is done on the index.
+        // If it's not in the write-set, return lval.
+        inline uint64_t lookupAddr(const void* addr, uint64_t lval) {
+            const uint64_t h = hash(addr);
+            if (!filterMayContain(h)) return lval;
+            const uint64_t eidx = indexFind(addr, h);
+            return (eidx == NO_ENTRY) ? lval : entry(eidx).val;
+        }
+
+        // Adds 'delta' to the tmcounter at 'addr'. If the counter has a store in the log, the delta is added to it,
+        // otherwise it goes to the entry of addr|DELTA (which has the same hash as addr), where the deltas of the
+        // transaction are summed up until foldDeltas().
+        inline void addDelta(void* addr, uint64_t delta) {
+            void* const daddr = (void*)((uintptr_t)addr | DELTA);
+            if (numStores != 0) {
+                const uint64_t h = hash(addr);
+                if (filterMayContain(h)) {
+                    uint64_t eidx = indexFind(addr, h);
+                    if (eidx == NO_ENTRY) eidx = indexFind(daddr, h);
+                    if (eidx != NO_ENTRY) {
+                        entry(eidx).val += delta;
                         return;
                     }
-                    be = be->next;
                 }
             }
+            addOrReplace(daddr, delta);
+            numDeltas++;
+        }
+
+        // Same as lookupAddr(), for a tmcounter: if the counter has no store in the log, returns lval plus the deltas
+        inline uint64_t lookupCounter(const void* addr, uint64_t lval) {
+            const uint64_t h = hash(addr);
+            if (!filterMayContain(h)) return lval;
+            uint64_t eidx = indexFind(addr, h);
+            if (eidx != NO_ENTRY) return entry(eidx).val;
+            eidx = indexFind((void*)((uintptr_t)addr | DELTA), h);
+            return (eidx == NO_ENTRY) ? lval : lval + entry(eidx).val;
         }
-        // Add to array
-        WriteSetEntry* e = &log[numStores++];
-        assert(numStores < TX_MAX_STORES);
-        e->addr = addr;
-        e->val = val;
-        // Add to hashmap
-        WriteSetEntry* be = buckets[hashAddr];
-        // Clear if entry is from previous tx
-        e->next = (be < e && hash(be->addr) == hashAddr) ? be : nullptr;
-        buckets[hashAddr] = e;
-    }
 
-    // Does a lookup on the WriteSet for an addr.
-    // If the numStores is lower than MAX_ARRAY_LOOKUP, the lookup is done on the log, otherwise, the lookup is done on the hashmap.
-    // If it's not in the write-set, return lval.
-    inline uint64_t lookupAddr(const void* addr, uint64_t lval) {
-        if (numStores < MAX_ARRAY_LOOKUP) {
-            // Lookup in array
-            for (unsigned int idx = 0; idx < numStores; idx++) {
-                if (log[idx].addr == addr) return log[idx].val;
+        // Replaces the entry with the deltas of each tmcounter by a store of its final value, which is then applied
+        // like any other store. Called by commitTx() before publishing the write-set: if another transaction modifies
+        // a counter after we've read it here, the CAS on curTx fails and the transaction is executed again.
+        inline void foldDeltas() {
+            for (uint64_t i = 0; i < numStores && numDeltas > 0; i++) {
+                WriteSetEntry& e = entry(i);
+                if (((uintptr_t)e.addr & DELTA) == 0) continue;
+                e.addr = (void*)((uintptr_t)e.addr & ~DELTA);
+                e.val += ((tmtypebase<uint64_t>*)e.addr)->val.load(std::memory_order_acquire);
+                numDeltas--;
             }
-        } else {
-            // Lookup in hashmap
-            const uint64_t hashAddr = hash(addr);
-            WriteSetEntry* be = buckets[hashAddr];
-            if (be < &log[numStores] && hash(be->addr) == hashAddr) {
-                while (be != nullptr) {
-                    if (be->addr == addr) return be->val;
-                    be = be->next;
-                }
+        }
+
+        // Returns true if there is an entry for addr in the log
+        inline bool contains(const void* addr) {
+            const uint64_t h = hash(addr);
+            return filterMayContain(h) && indexFind(addr, h) != NO_ENTRY;
+        }
+
+        // Assignment operator, used when making a copy of a WriteSet to help another thread.
+        // We walk the linked chunks of 'other' because its 'chunks' belongs to the owner thread.
+        // If the log of 'other' changes during the copy, the copy may be incomplete, but helpApply() will discard it.
+        WriteSet& operator = (const WriteSet &other) {
+            const uint64_t otherNumStores = other.numStores;
+            reserve(otherNumStores);
+            const WriteSetChunk* src = &other.first;
+            uint64_t i = 0;
+            for (; i < otherNumStores && src != nullptr; i += TX_CHUNK_STORES) {
+                const uint64_t len = std::min(TX_CHUNK_STORES, otherNumStores-i);
+                WriteSetEntry* dst = chunks[i/TX_CHUNK_STORES]->log;
+                for (uint64_t j = 0; j < len; j++) dst[j] = src->log[j];
+                src = src->next.load(std::memory_order_acquire);
             }
+            numStores = std::min(i, otherNumStores);
+            return *this;
         }
-        return lval;
-    }
 
-    // Assignment operator, used when making a copy of a WriteSet to help another thread
-    WriteSet& operator = (const WriteSet &other) {
-        numStores = other.numStores;
-        for (uint64_t i = 0; i < numStores; i++) log[i] = other.log[i];
-        return *this;
-    }
+        // Copies the entries [from,to) of the log into 'dst', walking the linked chunks.
+        // Used by helpers in cooperativeApply(), the range must be inside a single chunk.
+        // Returns false if the log changed during the walk, in which case the request is no longer open.
+        inline bool copyEntries(uint64_t from, uint64_t to, WriteSetEntry* dst) const {
+            const WriteSetChunk* src = &first;
+            for (uint64_t i = TX_CHUNK_STORES; i <= from; i += TX_CHUNK_STORES) {
+                src = src->next.load(std::memory_order_acquire);
+                if (src == nullptr) return false;
+            }
+            for (uint64_t i = from; i < to; i++) dst[i-from] = src->log[i % TX_CHUNK_STORES];
+            return true;
+        }
 
-    // Applies all entries in the log as DCASes.
-    // Seq must match for DCAS to succeed. This method is on the "hot-path".
-    inline void apply(uint64_t seq, const int tid) {
-        for (uint64_t i = 0; i < numStores; i++) {
-            // Use an heuristic to give each thread 8 consecutive DCAS to apply
-            WriteSetEntry& e = log[(tid*8 + i) % numStores];
+        // Applies one entry of a log as a DCAS. Seq must match for DCAS to succeed.
+        static inline void applyEntry(const WriteSetEntry& e, uint64_t seq) {
             tmtypebase<uint64_t>* tmte = (tmtypebase<uint64_t>*)e.addr;
             uint64_t lval = tmte->val.load(std::memory_order_acquire);
             uint64_t lseq = tmte->seq.load(std::memory_order_acquire);
             if (lseq < seq) DCAS((uint64_t*)e.addr, lval, lseq, e.val, seq);
         }
-    }
-};
 
+        // Sorts the log by address, one chunk at a time. This breaks the index, therefore, it can only be
+        // called once there are no more stores in the transaction.
+        inline void sortByAddress() {
+            for (uint64_t i = 0; i < numStores; i += TX_CHUNK_STORES) {
+                WriteSetEntry* log = chunks[i/TX_CHUNK_STORES]->log;
+                std::sort(log, log + std::min(TX_CHUNK_STORES, numStores-i),
+                          [] (const WriteSetEntry& a, const WriteSetEntry& b) { return a.addr < b.addr; });
+            }
+        }
 
-// Forward declaration
-struct OpData;
-// This is used by addOrReplace() to know which OpData instance to use for the current transaction
-extern thread_local OpData* tl_opdata;
+        // Applies all entries in the log as DCASes.
+        // Seq must match for DCAS to succeed. This method is on the "hot-path".
+        // The words are (mostly) in random places in memory, so we prefetch the ones coming ahead.
+        inline void apply(uint64_t seq, const int tid, const uint64_t prefetchDistance=TX_PREFETCH_DISTANCE) {
+            for (uint64_t i = 0; i < numStores; i++) {
+                if (prefetchDistance != 0) __builtin_prefetch(entry((tid*8 + i + prefetchDistance) % numStores).addr, 1);
+                // Use an heuristic to give each thread 8 consecutive DCAS to apply
+                applyEntry(entry((tid*8 + i) % numStores), seq);
+            }
+        }
+    };
+
+
+    // Forward declaration
+    struct OpData;
+    // This is used by addOrReplace() to know which OpData instance to use for the current transaction
+    static thread_local OpData* tl_opdata;
+
+
+    // Its purpose is to hold thread-local data.
+    // Each instance is allocated by its owner thread the first time it executes a transaction, and the logs
+    // grow up to the largest transaction this thread has done, so there is no memory taken by unused threads.
+    struct alignas(128) OpData {
+        uint64_t               curTx {0};                   // Used during a transaction to keep the value of currTx read in beginTx() (owner thread only)
+        std::atomic<uint64_t>  request {0};                 // Can be moved to CLOSED by other threads, using a CAS
+        std::atomic<uint64_t>  applyNext {0};               // Next range of the write-set to apply, tagged with the seq of the request
+        std::atomic<uint64_t>  applyDone {0};               // Number of ranges already applied, tagged with the seq of the request
+        uint64_t               nestedTrans {0};             // Thread-local: Number of nested transactions
+        std::vector<tmbase*>   rlog;                        // List of retired objects during the transaction (owner thread only)
+        std::vector<Deletable> alog;                        // List of newly allocated objects during the transaction (owner thread only)
+        WriteSet               writeSet;                    // Redo log of the current transaction, or a copy of the one we're helping
+        TxCounters<TX_STATS>   stats;                       // Transaction statistics of this thread (see TxStats)
+        uint64_t               aborts {0};                  // Consecutive aborts of the current transaction (owner thread only)
+        uint64_t               backoffSeed {0};             // State of the random generator of the backoff (owner thread only)
+        std::atomic<uint64_t>  numCommits {0};              // Contention counters of this thread, read by getContentionStats()
+        std::atomic<uint64_t>  numAborts {0};
+        std::atomic<uint64_t>  numEscalations {0};
+        std::atomic<uint64_t>  maxAborts {0};
+
+        // Returns true if 'addr' is inside one of the last TX_CAPTURE_ALLOCS objects allocated in the current transaction.
+        // These objects can't be reached by other threads until the transaction commits, so their stores can be done
+        // in place, without going through the write-set.
+        // We look only at the last few allocations because this is called on every store. This also means that an object
+        // can go from captured to not captured during a transaction, but never the other way around, which is what
+        // keeps a store in place from being overwritten by an older store in the write-set.
+        // With 'size', all the bytes from 'addr' to 'addr+size' must be inside the same object.
+        inline bool isCaptured(const void* addr, const size_t size=1) const {
+            for (uint64_t i = alog.size(); i > 0 && i+TX_CAPTURE_ALLOCS > alog.size(); i--) {
+                const Deletable& del = alog[i-1];
+                if ((uint8_t*)addr >= (uint8_t*)del.obj && (uint8_t*)addr+size <= (uint8_t*)del.obj + del.size) return true;
+            }
+            return false;
+        }
+    };
 
 
-// Its purpose is to hold thread-local data
-struct OpData {
-    uint64_t              curTx {0};                   // Used during a transaction to keep the value of currTx read in beginTx() (owner thread only)
-    std::atomic<uint64_t> request {0};                 // Can be moved to CLOSED by other threads, using a CAS
-    uint64_t              nestedTrans {0};             // Thread-local: Number of nested transactions
-    uint64_t              numRetires {0};              // Number of calls to retire() in this transaction (owner thread only)
-    tmbase*               rlog[TX_MAX_RETIRES];        // List of retired objects during the transaction (owner thread only)
-    uint64_t              numAllocs {0};               // Number of calls to tmNew() in this transaction (owner thread only)
-    Deletable             alog[TX_MAX_ALLOCS];         // List of newly allocated objects during the transaction (owner thread only)
-};
+    class OneFileLF;
+    static OneFileLF& gOFLF;
 
 
-// Used to identify aborted transactions
-struct AbortedTx {};
-static constexpr AbortedTx AbortedTxException {};
+    /**
+     * <h1> One-File STM (Lock-Free) </h1>
+     *
+     * OneFile is a Software Transacional Memory with lock-free progress, meant to
+     * implement lock-free data structures. It has integrated lock-free memory
+     * reclamation using Hazard Eras: https://dl.acm.org/citation.cfm?id=3087588
+     *
+     * OneFile is a word-based STM and it uses double-compare-and-swap (DCAS).
+     *
+     * Right now it has several limitations, some will be fixed in the future, some may be hard limitations of this approach:
+     * - We can't have stack allocated tmtype<> variables. For example, we can't created inside a transaction "tmtpye<uint64_t> tmp = a;",
+     *   it will give weird errors because of stack allocation.
+     * - We need DCAS but it can be emulated with LL/SC or even with single-word CAS
+     *   if we do redirection to a (lock-free) pool with SeqPtrs;
+     *
+     * Each instance of OneFileLF is an independent domain, with its own curTx, write-sets and Hazard Eras,
+     * so that data structures in different domains can commit in parallel. The static updateTx()/readTx()
+     * use the default domain gOFLF. A transaction must only access tmtypes of its own domain, and
+     * transactions of different domains do not compose: a transaction on domain B started from inside a
+     * transaction on domain A is a separate transaction, which commits independently of the one on A.
+     *
+     * In the commit combining mode, a thread whose commit fails (because another thread won the CAS on curTx)
+     * announces its transaction in operations[] instead of re-executing it on its own, and the next thread to
+     * commit an update transaction executes the announced transactions as part of its own, saving their
+     * results in results[], similarly to the flat combining in RomulusLog. Several transactions are then
+     * committed with a single transition of curTx. Combining happens at the level of transactions, not of
+     * write-sets, because OneFile has no read-sets to tell whether two write-sets can be merged.
+     * In this mode, the lambdas may be executed by other threads after the transaction returns (and
+     * then aborted), therefore they must capture by value, like in OneFileWF.
+     *
+     * The retries of a transaction that aborts (or fails the CAS on curTx) follow a contention management policy:
+     * CM_NONE retries immediately, CM_BACKOFF waits for a random time that doubles with each consecutive abort, and
+     * CM_KARMA does the same, but a transaction that has aborted TX_KARMA_ABORTS times in a row gets priority: the
+     * other threads wait (for a bounded time, to keep lock-freedom) before starting a new attempt, or, in the commit
+     * combining mode, the transaction is announced so that the next thread to commit executes it.
+     *
+     * The hybrid mode gives the throughput of the lock-free path in the common case and bounds the latency under
+     * contention, without the cost of the announcement in every transaction that OneFileWF pays: a transaction
+     * runs on the lock-free path until it has failed TX_HYBRID_ABORTS times in a row, and then it is announced
+     * like in the commit combining mode. Announcing increments numAnnounced, which is the only thing the other
+     * threads check on the fast path, and from then on every update transaction that commits executes it, so it
+     * completes after at most one commit per thread. Like in the commit combining mode, the lambdas must capture
+     * by value. Transactions that can't be announced (see isCombinable()) stay on the lock-free path.
+     */
+    class OneFileLF {
+    private:
+        static const bool                    debug = false;
+        HazardErasOF                         he {};
+        std::atomic<OpData*>                 opData[REGISTRY_MAX_THREADS];  // Allocated by each thread on its first transaction
+        // The lower bits of OpData::applyNext/applyDone count ranges, the upper bits have the seq of the request
+        static const uint64_t                APPLY_SHIFT = 20;
+        static const uint64_t                APPLY_MASK = (1ULL << APPLY_SHIFT)-1;
+        // Write-sets with fewer ranges than this are applied with a full pass by each thread
+        static const uint64_t                MIN_APPLY_RANGES = 4;
+        // Member variables for commit combining
+        const bool                           combining;
+        tmtypebase<uint64_t>*                operations;  // Announced TransFunc* of each thread
+        tmtypebase<uint64_t>*                results;     // Result of the last announced TransFunc of each thread
+        alignas(128) std::atomic<uint64_t>   numAnnounced {0};  // Number of threads with an announced transaction
+        std::atomic<uint64_t>                hybridAborts;      // Aborts before announcing, in the hybrid mode. Zero if disabled.
+        // Member variables for contention management
+        static const uint64_t                NO_PRIORITY = ~0ULL;
+        std::atomic<ContentionPolicy>        cmPolicy;
+        alignas(128) std::atomic<uint64_t>   priorityTid {NO_PRIORITY};  // Thread whose transaction has priority, with CM_KARMA
+
+    public:
+        std::atomic<uint64_t>                pad0[16];  // two cache lines of padding, before and after curTx
+        std::atomic<uint64_t>                curTx {seqidx2trans(1,0)};
+        std::atomic<uint64_t>                pad1[15];
+
+        // Contention counters of a domain, summed over all threads by getContentionStats()
+        struct ContentionStats {
+            uint64_t commits {0};      // Transactions committed by transaction()
+            uint64_t aborts {0};       // Failed attempts of these transactions
+            uint64_t escalations {0};  // Transactions that got priority with CM_KARMA, or were announced in the hybrid mode
+            uint64_t maxAborts {0};    // Largest number of consecutive aborts of a single transaction
+        };
+
+        // Set 'combining' to true to enable the commit combining mode on this domain, or 'hybrid' for the hybrid mode
+        OneFileLF(bool combining=TX_COMBINING, ContentionPolicy cm=TX_CONTENTION, bool hybrid=TX_HYBRID)
+            : combining{combining}, hybridAborts{hybrid ? TX_HYBRID_ABORTS : 0}, cmPolicy{cm} {
+            for (unsigned i = 0; i < REGISTRY_MAX_THREADS; i++) opData[i].store(nullptr, std::memory_order_relaxed);
+            operations = new tmtypebase<uint64_t>[REGISTRY_MAX_THREADS];
+            results = new tmtypebase<uint64_t>[REGISTRY_MAX_THREADS];
+            for (unsigned i = 0; i < REGISTRY_MAX_THREADS; i++) {
+                operations[i].rawStore(0, 0);
+                results[i].rawStore(0, 1);
+            }
+        }
 
-class OneFileLF;
-extern OneFileLF gOFLF;
+        ~OneFileLF() {
+            for (unsigned i = 0; i < REGISTRY_MAX_THREADS; i++) delete opData[i].load();
+            delete[] operations;
+            delete[] results;
+        }
 
+        // The contention management policy and the hybrid mode of the default domain show up in the name, for the benchmarks
+        static std::string className() {
+            const ContentionPolicy cm = gOFLF.getContentionPolicy();
+            return std::string("OneFileSTM-LF") + (cm == CM_BACKOFF ? "-Backoff" : cm == CM_KARMA ? "-Karma" : "") +
+                   (gOFLF.isHybrid() ? "-Hybrid" : "");
+        }
 
-/**
- * <h1> One-File STM (Lock-Free) </h1>
- *
- * OneFile is a Software Transacional Memory with lock-free progress, meant to
- * implement lock-free data structures. It has integrated lock-free memory
- * reclamation using Hazard Eras: https://dl.acm.org/citation.cfm?id=3087588
- *
- * OneFile is a word-based STM and it uses double-compare-and-swap (DCAS).
- *
- * Right now it has several limitations, some will be fixed in the future, some may be hard limitations of this approach:
- * - We can't have stack allocated tmtype<> variables. For example, we can't created inside a transaction "tmtpye<uint64_t> tmp = a;",
- *   it will give weird errors because of stack allocation.
- * - We need DCAS but it can be emulated with LL/SC or even with single-word CAS
- *   if we do redirection to a (lock-free) pool with SeqPtrs;
- */
-class OneFileLF {
-private:
-    static const bool                    debug = false;
-    HazardErasOF                         he {};
-    OpData                              *opData;
+        // Enables or disables the hybrid mode of this domain, in which a transaction is announced after 'aborts'
+        // consecutive aborts. Can be called while transactions are ongoing.
+        void setHybrid(bool hybrid, uint64_t aborts=TX_HYBRID_ABORTS) {
+            hybridAborts.store(hybrid ? std::max<uint64_t>(aborts, 1) : 0, std::memory_order_relaxed);
+        }
+        bool isHybrid() const { return hybridAborts.load(std::memory_order_relaxed) != 0; }
+
+        // Changes the contention management policy of this domain. Can be called while transactions are ongoing.
+        void setContentionPolicy(ContentionPolicy cm) { cmPolicy.store(cm, std::memory_order_relaxed); }
+        ContentionPolicy getContentionPolicy() const { return cmPolicy.load(std::memory_order_relaxed); }
+
+        // Progress condition: wait-free population oblivious (apart from the allocation)
+        // Returns the OpData of thread 'tid', allocating it if this is the first transaction for this tid.
+        // The OpData is allocated and initialized by the owner thread so that, on a first-touch
+        // NUMA policy (the default in Linux), its pages are local to the node where the thread runs.
+        // When a thread de-registers, the next thread to get the same tid re-uses the OpData.
+        inline OpData& getOpData(const int tid) {
+            OpData* opd = opData[tid].load(std::memory_order_relaxed);
+            if (opd != nullptr) return *opd;
+            opd = new OpData();
+            opData[tid].store(opd, std::memory_order_release);
+            return *opd;
+        }
 
-public:
-    std::atomic<uint64_t>                pad0[16];  // two cache lines of padding, before and after curTx
-    std::atomic<uint64_t>                curTx {seqidx2trans(1,0)};
-    std::atomic<uint64_t>                pad1[15];
-    WriteSet                            *writeSets;                    // Two write-sets for each thread
-
-    OneFileLF() {
-        opData = new OpData[REGISTRY_MAX_THREADS];
-        writeSets = new WriteSet[REGISTRY_MAX_THREADS];
-    }
+        // Progress Condition: lock-free
+        // The while-loop retarts only if there was at least one other thread completing a transaction
+        void beginTx(OpData& myopd, const int tid) {
+            tl_is_read_only = true;
+            // Clear the logs of the previous transaction
+            deleteAllocsFromLog(myopd);
+            myopd.rlog.clear();
+            while (true) {
+                myopd.curTx = curTx.load(std::memory_order_acquire);
+                helpApply(myopd.curTx, tid);
+                // Reset the write-set after (possibly) helping another transaction complete
+                myopd.writeSet.numStores = 0;
+                myopd.writeSet.shrink(he, curTx, tid);
+                // Use HE to protect the objects we're going to access during the simulation
+                he.set(myopd.curTx, tid);
+                // Start over if there is already a new transaction
+                if (myopd.curTx == curTx.load(std::memory_order_acquire)) return;
+                myopd.stats.onAbortBegin();
+            }
+        }
 
-    ~OneFileLF() {
-        delete[] opData;
-        delete[] writeSets;
-    }
+        // Progress condition: wait-free population-oblivious
+        // Attempts to publish our write-set (commit the transaction) and then applies the write-set.
+        // Returns true if my transaction was committed.
+        inline bool commitTx(OpData& myopd, const int tid) {
+            // If it's a read-only transaction, then commit immediately
+            if (myopd.writeSet.numStores == 0 && myopd.rlog.empty()) {
+                myopd.stats.onCommit(0, myopd.alog.size(), 0);
+                return true;
+            }
+            // Give up if the currTx has changed sinced our transaction started
+            if (myopd.curTx != curTx.load(std::memory_order_acquire)) {
+                myopd.stats.onAbortCommit();
+                return false;
+            }
+            // Turn the deltas of the tmcounters into stores, now that the counters can't change unless our commit fails
+            if (myopd.writeSet.numDeltas > 0) myopd.writeSet.foldDeltas();
+            // Sort the log so that apply() touches the words of each node one after the other
+            if (TX_APPLY_SORTED) myopd.writeSet.sortByAddress();
+            // Move our request to OPEN, using the sequence of the previous transaction +1
+            uint64_t seq = trans2seq(myopd.curTx);
+            uint64_t newTx = seqidx2trans(seq+1,tid);
+            myopd.applyNext.store((seq+1) << APPLY_SHIFT, std::memory_order_relaxed);
+            myopd.applyDone.store((seq+1) << APPLY_SHIFT, std::memory_order_relaxed);
+            myopd.request.store(newTx, std::memory_order_release);
+            // Attempt to CAS currTx to our OpDesc instance (tid) incrementing the seq in it
+            uint64_t lcurrTx = myopd.curTx;
+            if (debug) printf("tid=%i  attempting CAS on curTx from (%ld,%ld) to (%ld,%ld)\n", tid, trans2seq(lcurrTx), trans2idx(lcurrTx), seq+1, (uint64_t)tid);
+            if (!curTx.compare_exchange_strong(lcurrTx, newTx)) {
+                myopd.stats.onAbortCommit();
+                return false;
+            }
+            // Execute each store in the write-set using DCAS() and close the request
+            helpApply(newTx, tid);
+            myopd.stats.onCommit(myopd.writeSet.numStores, myopd.alog.size(), myopd.rlog.size());
+            retireRetiresFromLog(myopd, tid);
+            myopd.alog.clear();
+            if (debug) printf("Committed transaction (%ld,%ld) with %ld stores\n", seq+1, (uint64_t)tid, myopd.writeSet.numStores);
+            return true;
+        }
 
-    static std::string className() { return "OneFileSTM-LF"; }
-
-    // Progress Condition: lock-free
-    // The while-loop retarts only if there was at least one other thread completing a transaction
-    void beginTx(OpData& myopd, const int tid) {
-        tl_is_read_only = true;
-        // Clear the logs of the previous transaction
-        deleteAllocsFromLog(myopd);
-        myopd.numRetires = 0;
-        while (true) {
-            myopd.curTx = curTx.load(std::memory_order_acquire);
-            helpApply(myopd.curTx, tid);
-            // Reset the write-set after (possibly) helping another transaction complete
-            writeSets[tid].numStores = 0;
-            // Use HE to protect the objects we're going to access during the simulation
-            he.set(myopd.curTx, tid);
-            // Start over if there is already a new transaction
-            if (myopd.curTx == curTx.load(std::memory_order_acquire)) return;
+        // Same as beginTx/endTx transaction, but with lambdas, and it handles AbortedTx exceptions
+        template<typename R, typename F> R transaction(F&& func) {
+            const int tid = ThreadRegistry::getTID();
+            OpData& myopd = getOpData(tid);
+            if (myopd.nestedTrans > 0) return func();
+            ++myopd.nestedTrans;
+            // Save the thread-locals in case we're inside a transaction on another domain
+            OpData* const prevopd = tl_opdata;
+            const bool prevro = tl_is_read_only;
+            tl_opdata = &myopd;
+            R retval {};
+            while (true) {
+                waitForPriority(tid);
+                beginTx(myopd, tid);
+                try {
+                    retval = func();
+                    if (myopd.writeSet.numStores != 0 && numAnnounced.load(std::memory_order_acquire) != 0) combineAll(myopd);
+                } catch (AbortedTx&) {
+                    myopd.stats.onAbortLoad();
+                    if (!contentionAbort(myopd, isCombinable<R,F>(), tid)) continue;
+                    combinedTransaction<R>(myopd, func, tid, retval);
+                    break;
+                }
+                if (commitTx(myopd, tid)) break;
+                if ((combining && isCombinable<R,F>()) || contentionAbort(myopd, isCombinable<R,F>(), tid)) {
+                    combinedTransaction<R>(myopd, func, tid, retval);
+                    break;
+                }
+            }
+            contentionCommit(myopd, tid);
+            tl_opdata = prevopd;
+            tl_is_read_only = prevro;
+            --myopd.nestedTrans;
+            he.clear(tid);
+            return retval;
         }
-    }
 
-    // Progress condition: wait-free population-oblivious
-    // Attempts to publish our write-set (commit the transaction) and then applies the write-set.
-    // Returns true if my transaction was committed.
-    inline bool commitTx(OpData& myopd, const int tid) {
-        // If it's a read-only transaction, then commit immediately
-        if (writeSets[tid].numStores == 0 && myopd.numRetires == 0) return true;
-        // Give up if the currTx has changed sinced our transaction started
-        if (myopd.curTx != curTx.load(std::memory_order_acquire)) return false;
-        // Move our request to OPEN, using the sequence of the previous transaction +1
-        uint64_t seq = trans2seq(myopd.curTx);
-        uint64_t newTx = seqidx2trans(seq+1,tid);
-        myopd.request.store(newTx, std::memory_order_release);
-        // Attempt to CAS currTx to our OpDesc instance (tid) incrementing the seq in it
-        uint64_t lcurrTx = myopd.curTx;
-        if (debug) printf("tid=%i  attempting CAS on curTx from (%ld,%ld) to (%ld,%ld)\n", tid, trans2seq(lcurrTx), trans2idx(lcurrTx), seq+1, (uint64_t)tid);
-        if (!curTx.compare_exchange_strong(lcurrTx, newTx)) return false;
-        // Execute each store in the write-set using DCAS() and close the request
-        helpApply(newTx, tid);
-        retireRetiresFromLog(myopd, tid);
-        myopd.numAllocs = 0;
-        if (debug) printf("Committed transaction (%ld,%ld) with %ld stores\n", seq+1, (uint64_t)tid, writeSets[tid].numStores);
-        return true;
-    }
+        // Same as above, but returns void
+        template<typename F> void transaction(F&& func) {
+            const int tid = ThreadRegistry::getTID();
+            OpData& myopd = getOpData(tid);
+            if (myopd.nestedTrans > 0) {
+                func();
+                return;
+            }
+            ++myopd.nestedTrans;
+            OpData* const prevopd = tl_opdata;
+            const bool prevro = tl_is_read_only;
+            tl_opdata = &myopd;
+            uint64_t notused;
+            while (true) {
+                waitForPriority(tid);
+                beginTx(myopd, tid);
+                try {
+                    func();
+                    if (myopd.writeSet.numStores != 0 && numAnnounced.load(std::memory_order_acquire) != 0) combineAll(myopd);
+                } catch (AbortedTx&) {
+                    myopd.stats.onAbortLoad();
+                    if (!contentionAbort(myopd, isCombinable<void,F>(), tid)) continue;
+                    combinedTransaction<void>(myopd, func, tid, notused);
+                    break;
+                }
+                if (commitTx(myopd, tid)) break;
+                if ((combining && isCombinable<void,F>()) || contentionAbort(myopd, isCombinable<void,F>(), tid)) {
+                    combinedTransaction<void>(myopd, func, tid, notused);
+                    break;
+                }
+            }
+            contentionCommit(myopd, tid);
+            tl_opdata = prevopd;
+            tl_is_read_only = prevro;
+            --myopd.nestedTrans;
+            he.clear(tid);
+        }
 
-    // Same as beginTx/endTx transaction, but with lambdas, and it handles AbortedTx exceptions
-    template<typename R, typename F> R transaction(F&& func) {
-        const int tid = ThreadRegistry::getTID();
-        OpData& myopd = opData[tid];
-        if (myopd.nestedTrans > 0) return func();
-        ++myopd.nestedTrans;
-        tl_opdata = &myopd;
-        R retval {};
-        while (true) {
-            beginTx(myopd, tid);
-            try {
-                retval = func();
-            } catch (AbortedTx&) {
-                continue;
-            }
-            if (commitTx(myopd, tid)) break;
-        }
-        tl_opdata = nullptr;
-        --myopd.nestedTrans;
-        he.clear(tid);
-        return retval;
-    }
+        // Update transactions on this domain
+        template<typename R, typename F> R updateTransaction(F&& func) { return transaction<R>(func); }
+        template<typename F> void updateTransaction(F&& func) { transaction(func); }
+
+        // Progress condition: lock-free
+        // Read-only transactions on this domain. Unlike transaction(), they don't touch the logs of the previous
+        // transaction, and they only help the last transaction if its write-set is still being applied, because
+        // otherwise they could see some of its stores but not others.
+        // If the lambda turns out to have stores, allocations or retires, this execution is discarded and the
+        // lambda is executed again with transaction().
+        template<typename R, typename F> R readTransaction(F&& func) {
+            const int tid = ThreadRegistry::getTID();
+            OpData& myopd = getOpData(tid);
+            if (myopd.nestedTrans > 0) return func();
+            R retval {};
+            if (readOnlyTransaction(myopd, [&] () { retval = func(); }, tid)) return retval;
+            return transaction<R>(func);
+        }
 
-    // Same as above, but returns void
-    template<typename F> void transaction(F&& func) {
-        const int tid = ThreadRegistry::getTID();
-        OpData& myopd = opData[tid];
-        if (myopd.nestedTrans > 0) {
-            func();
-            return;
-        }
-        ++myopd.nestedTrans;
-        tl_opdata = &myopd;
-        while (true) {
-            beginTx(myopd, tid);
-            try {
+        // Same as above, but returns void
+        template<typename F> void readTransaction(F&& func) {
+            const int tid = ThreadRegistry::getTID();
+            OpData& myopd = getOpData(tid);
+            if (myopd.nestedTrans > 0) {
                 func();
-            } catch (AbortedTx&) {
-                continue;
+                return;
             }
-            if (commitTx(myopd, tid)) break;
+            if (!readOnlyTransaction(myopd, func, tid)) transaction(func);
         }
-        tl_opdata = nullptr;
-        --myopd.nestedTrans;
-        he.clear(tid);
-    }
 
-    // It's silly that these have to be static, but we need them for the (SPS) benchmarks due to templatization
-    template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
-    template<typename R, typename F> static R readTx(F&& func) { return gOFLF.transaction<R>(func); }
-    template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
-    template<typename F> static void readTx(F&& func) { gOFLF.transaction(func); }
-
-    // When inside a transaction, the user can't call "new" directly because if
-    // the transaction fails, it would leak the memory of these allocations.
-    // Instead, we provide an allocator that keeps pointers to these objects
-    // in a log, and in the event of a failed commit of the transaction, it will
-    // delete the objects so that there are no leaks.
-    // TODO: Add static_assert to check if T is of tmbase
-    template <typename T, typename... Args> static T* tmNew(Args&&... args) {
-        T* ptr = (T*)std::malloc(sizeof(T));
-        new (ptr) T(std::forward<Args>(args)...);  // new placement
-        ptr->newEra_ = trans2seq(gOFLF.curTx.load(std::memory_order_acquire));
-        OpData* myopd = tl_opdata;
-        if (myopd != nullptr) {
-            assert(myopd->numAllocs != TX_MAX_ALLOCS);
-            Deletable& del = myopd->alog[myopd->numAllocs++];
-            del.obj = ptr;
-            // This func ptr to a lambda gives us a way to call the destructor
-            // when a transaction aborts.
-            del.reclaim = [](void* obj) { static_cast<T*>(obj)->~T(); std::free(obj); };
-        }
-        return ptr;
-    }
+        // Executes func(args[i]) for each i in [0,n), with each update transaction executing a group of consecutive
+        // arguments instead of a single one, which shares the begin and the commit of the transaction between the
+        // operations of the group. If 'results' isn't nullptr, results[i] gets the value returned by func(args[i]).
+        // The size of the groups adapts to the operations: starting from TX_BATCH_MAX_OPS, it halves when a group does
+        // more than TX_BATCH_STORES stores, and it doubles when it does less than half of that, so that heavy operations
+        // don't make large transactions, which conflict more often.
+        // The operations of a group are atomic together, but not with the operations of the other groups.
+        // 'func' may be executed by other threads in the commit combining and hybrid modes, even after this method has
+        // returned, so it must not modify anything outside of the transaction nor read memory of the caller, which may be
+        // gone by then. Each group gets its own copy of 'func' and of its arguments, and the results come back in the
+        // result of the transaction.
+        template<typename K, typename F> void updateTransactionBatch(const K* args, const size_t n, bool* results, F&& func) {
+            struct BatchResult { uint64_t mask; uint64_t stores; };
+            static_assert(TX_BATCH_MAX_OPS > 0 && TX_BATCH_MAX_OPS <= 64, "TX_BATCH_MAX_OPS must be between 1 and 64");
+            uint64_t ops = TX_BATCH_MAX_OPS;
+            for (size_t first = 0; first < n; ) {
+                const uint64_t num = std::min<uint64_t>(ops, n-first);
+                std::array<K,TX_BATCH_MAX_OPS> group {};
+                std::copy_n(args+first, num, group.begin());
+                const BatchResult res = updateTransaction<BatchResult>([func,group,num] () -> BatchResult {
+                    // A helper may be executing the groups of other threads in the same transaction
+                    const uint64_t startStores = tl_opdata->writeSet.numStores;
+                    uint64_t mask = 0;
+                    for (uint64_t i = 0; i < num; i++) if (func(group[i])) mask |= 1ULL << i;
+                    return {mask, tl_opdata->writeSet.numStores - startStores};
+                });
+                if (results != nullptr) {
+                    for (uint64_t i = 0; i < num; i++) results[first+i] = (res.mask >> i) & 1;
+                }
+                first += num;
+                if (res.stores > TX_BATCH_STORES && ops > 1) ops /= 2;
+                else if (2*res.stores < TX_BATCH_STORES && ops < TX_BATCH_MAX_OPS) ops *= 2;
+            }
+        }
 
-    // The user can not directly delete objects in the transaction because the
-    // transaction may fail and needs to be retried and other threads may be
-    // using those objects.
-    // Instead, it has to call retire() for the objects it intends to delete.
-    // The retire() puts the objects in the rlog, and only when the transaction
-    // commits, the objects are put in the Hazard Eras retired list.
-    // The del.delEra is filled in retireRetiresFromLog().
-    // TODO: Add static_assert to check if T is of tmbase
-    template<typename T> static void tmDelete(T* obj) {
-        if (obj == nullptr) return;
-        obj->~T(); // Execute destructor as part of the current transaction
-        OpData* myopd = tl_opdata;
-        if (myopd == nullptr) {
-            std::free(obj);  // Outside a transaction, just delete the object
-            return;
-        }
-        assert(myopd->numRetires != TX_MAX_RETIRES);
-        myopd->rlog[myopd->numRetires++] = obj;
-    }
+        // Same as updateTransactionBatch(), with read-only transactions of TX_BATCH_MAX_OPS operations each
+        template<typename K, typename F> void readTransactionBatch(const K* args, const size_t n, bool* results, F&& func) {
+            for (size_t first = 0; first < n; first += TX_BATCH_MAX_OPS) {
+                const uint64_t num = std::min<uint64_t>(TX_BATCH_MAX_OPS, n-first);
+                std::array<K,TX_BATCH_MAX_OPS> group {};
+                std::copy_n(args+first, num, group.begin());
+                const uint64_t mask = readTransaction<uint64_t>([func,group,num] () -> uint64_t {
+                    uint64_t mask = 0;
+                    for (uint64_t i = 0; i < num; i++) if (func(group[i])) mask |= 1ULL << i;
+                    return mask;
+                });
+                if (results == nullptr) continue;
+                for (uint64_t i = 0; i < num; i++) results[first+i] = (mask >> i) & 1;
+            }
+        }
 
-    // We snap a tmbase at the beginning of the allocation
-    static void* tmMalloc(size_t size) {
-        uint8_t* ptr = (uint8_t*)std::malloc(size+sizeof(tmbase));
-        // We must reset the contents to zero to guarantee that if any tmtypes are allocated inside, their 'seq' will be zero
-        std::memset(ptr+sizeof(tmbase), 0, size);
-        ((tmbase*)ptr)->newEra_ = trans2seq(gOFLF.curTx.load(std::memory_order_acquire));
-        OpData* myopd = tl_opdata;
-        if (myopd != nullptr) {
-            assert(myopd->numAllocs != TX_MAX_ALLOCS);
-            Deletable& del = myopd->alog[myopd->numAllocs++];
-            del.obj = ptr;
-            del.reclaim = [](void* obj) { std::free(obj); };
-        }
-        return ptr + sizeof(tmbase);
-    }
+        // Counters of the memory reclamation of this domain (see HazardErasOF::Stats)
+        typename HazardErasOF::Stats getReclamationStats() const { return he.getStats(); }
 
-    // We assume there is a tmbase allocated in the beginning of the allocation
-    static void tmFree(void* obj) {
-        if (obj == nullptr) return;
-        OpData* myopd = tl_opdata;
-        uint8_t* ptr = (uint8_t*)obj - sizeof(tmbase);
-        if (myopd == nullptr) {
-            std::free(ptr);  // Outside a transaction, just free the object
-            return;
-        }
-        assert(myopd->numRetires != TX_MAX_RETIRES);
-        myopd->rlog[myopd->numRetires++] = (tmbase*)ptr;
-    }
+        // Progress condition: wait-free bounded (by the number of threads)
+        // Returns the transaction statistics of this domain (see TxStats). Meant for statistics, it's not an atomic snapshot.
+        TxStats getTxStats() const {
+            TxStats st {};
+            for (unsigned i = 0; i < REGISTRY_MAX_THREADS; i++) {
+                const OpData* opd = opData[i].load(std::memory_order_acquire);
+                if (opd != nullptr) opd->stats.addTo(st);
+            }
+            if (TX_STATS) st.retiredListLength = he.getStats().retired;
+            return st;
+        }
+
+        // Progress condition: wait-free bounded (by the number of threads)
+        // Returns the contention counters of this domain. Meant for statistics, it's not an atomic snapshot.
+        ContentionStats getContentionStats() const {
+            ContentionStats st {};
+            for (unsigned i = 0; i < REGISTRY_MAX_THREADS; i++) {
+                const OpData* opd = opData[i].load(std::memory_order_acquire);
+                if (opd == nullptr) continue;
+                st.commits += opd->numCommits.load(std::memory_order_relaxed);
+                st.aborts += opd->numAborts.load(std::memory_order_relaxed);
+                st.escalations += opd->numEscalations.load(std::memory_order_relaxed);
+                st.maxAborts = std::max(st.maxAborts, opd->maxAborts.load(std::memory_order_relaxed));
+            }
+            return st;
+        }
+
+        // It's silly that these have to be static, but we need them for the (SPS) benchmarks due to templatization.
+        // These use the default domain gOFLF.
+        template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
+        template<typename R, typename F> static R readTx(F&& func) { return gOFLF.readTransaction<R>(func); }
+        template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
+        template<typename F> static void readTx(F&& func) { gOFLF.readTransaction(func); }
+
+        // When inside a transaction, the user can't call "new" directly because if
+        // the transaction fails, it would leak the memory of these allocations.
+        // Instead, we provide an allocator that keeps pointers to these objects
+        // in a log, and in the event of a failed commit of the transaction, it will
+        // delete the objects so that there are no leaks.
+        // TODO: Add static_assert to check if T is of tmbase
+        template <typename T, typename... Args> static T* tmNew(Args&&... args) {
+            T* ptr = (T*)tl_cache.allocate(sizeof(T));
+            if (TX_PROFILE) gConflictProfiler.onAlloc(ptr, sizeof(T), 0, typeid(T).name());
+            OpData* myopd = tl_opdata;
+            // The allocation goes in the log before calling the constructor, so that the stores done by the
+            // constructor are captured. If the constructor throws, the rollback only frees the memory.
+            const uint64_t aidx = (myopd == nullptr) ? 0 : myopd->alog.size();
+            if (myopd != nullptr) myopd->alog.push_back({ptr, [](void* obj) { tl_cache.deallocate(obj); }, sizeof(T)});
+            new (ptr) T(std::forward<Args>(args)...);  // new placement
+            // Outside a transaction we don't know which domain the object will belong to, so we
+            // leave newEra_ at zero, which is conservative for Hazard Eras.
+            ptr->newEra_ = (myopd == nullptr) ? 0 : trans2seq(myopd->curTx);
+            if (myopd != nullptr) {
+                // This func ptr to a lambda gives us a way to call the destructor
+                // when a transaction aborts.
+                myopd->alog[aidx].reclaim = [](void* obj) { static_cast<T*>(obj)->~T(); tl_cache.deallocate(obj); };
+            }
+            return ptr;
+        }
 
-private:
-    // Progress condition: wait-free population oblivious
-    void helpApply(uint64_t lcurTx, const uint64_t tid) {
-        const uint64_t idx = trans2idx(lcurTx);
-        const uint64_t seq = trans2seq(lcurTx);
-        OpData& opd = opData[idx];
-        // Nothing to apply unless the request matches the curTx
-        if (lcurTx != opd.request.load(std::memory_order_acquire)) return;
-        if (idx != tid) {
-            // Make a copy of the write-set and check if it is consistent
-            writeSets[tid] = writeSets[idx];
-            // Use HE to protect the objects the transaction touches
-            he.set(lcurTx, tid);
-            if (lcurTx != curTx.load()) return;
-            // The published era is now protecting all objects alive in the transaction lcurTx
+        // The user can not directly delete objects in the transaction because the
+        // transaction may fail and needs to be retried and other threads may be
+        // using those objects.
+        // Instead, it has to call retire() for the objects it intends to delete.
+        // The retire() puts the objects in the rlog, and only when the transaction
+        // commits, the objects are put in the Hazard Eras retired list.
+        // The del.delEra is filled in retireRetiresFromLog().
+        // TODO: Add static_assert to check if T is of tmbase
+        template<typename T> static void tmDelete(T* obj) {
+            if (obj == nullptr) return;
+            obj->~T(); // Execute destructor as part of the current transaction
+            OpData* myopd = tl_opdata;
+            if (myopd == nullptr) {
+                tl_cache.deallocate(obj);  // Outside a transaction, just delete the object
+                return;
+            }
+            myopd->rlog.push_back(obj);
+        }
+
+        // We snap a tmbase at the beginning of the allocation
+        static void* tmMalloc(size_t size) {
+            uint8_t* ptr = (uint8_t*)tl_cache.allocate(size+sizeof(tmbase));
+            if (TX_PROFILE) gConflictProfiler.onAlloc(ptr, size+sizeof(tmbase), sizeof(tmbase), nullptr);
+            // We must reset the contents to zero to guarantee that if any tmtypes are allocated inside, their 'seq' will be zero
+            std::memset(ptr+sizeof(tmbase), 0, size);
+            OpData* myopd = tl_opdata;
+            ((tmbase*)ptr)->newEra_ = (myopd == nullptr) ? 0 : trans2seq(myopd->curTx);
+            if (myopd != nullptr) myopd->alog.push_back({ptr, [](void* obj) { tl_cache.deallocate(obj); }, size+sizeof(tmbase)});
+            return ptr + sizeof(tmbase);
+        }
+
+        // We assume there is a tmbase allocated in the beginning of the allocation
+        static void tmFree(void* obj) {
+            if (obj == nullptr) return;
+            OpData* myopd = tl_opdata;
+            uint8_t* ptr = (uint8_t*)obj - sizeof(tmbase);
+            if (myopd == nullptr) {
+                tl_cache.deallocate(ptr);  // Outside a transaction, just free the object
+                return;
+            }
+            myopd->rlog.push_back((tmbase*)ptr);
+        }
+
+    private:
+        // The lambda of an announced transaction, with the return value converted to (and from) an uint64_t
+        template<typename R, typename F> struct TransFuncOf : public TransFunc {
+            F func;
+            TransFuncOf(const F& f) : func{f} {
+                call = [] (TransFunc* tf) -> uint64_t {
+                    uint64_t res = 0;
+                    if constexpr (std::is_void<R>::value) {
+                        static_cast<TransFuncOf*>(tf)->func();
+                    } else if constexpr (sizeof(R) <= sizeof(uint64_t)) {
+                        // Larger results are never announced (see isCombinable()), but this is still instantiated for them
+                        R r = static_cast<TransFuncOf*>(tf)->func();
+                        std::memcpy(&res, &r, sizeof(R));
+                    }
+                    return res;
+                };
+            }
+        };
+
+        // Executes the lambda of a read-only transaction, retrying until it doesn't abort.
+        // Returns false if the lambda did stores, allocations or retires, in which case the caller has to execute
+        // it again with transaction(), which will rollback the allocations and retires.
+        template<typename F> bool readOnlyTransaction(OpData& myopd, F&& func, const int tid) {
+            ++myopd.nestedTrans;
+            OpData* const prevopd = tl_opdata;
+            const bool prevro = tl_is_read_only;
+            tl_opdata = &myopd;
+            const uint64_t alogSize = myopd.alog.size();
+            while (true) {
+                tl_is_read_only = true;
+                myopd.curTx = curTx.load(std::memory_order_acquire);
+                // Use HE to protect the objects we're going to access during the simulation
+                he.set(myopd.curTx, tid);
+                if (myopd.curTx != curTx.load()) {
+                    myopd.stats.onAbortBegin();
+                    continue;
+                }
+                // Returns immediately if the request of curTx is already closed
+                helpApply(myopd.curTx, tid);
+                // The write-set may have a copy of the one we helped, and it's also where stores would go
+                myopd.writeSet.numStores = 0;
+                try {
+                    func();
+                } catch (AbortedTx&) {
+                    myopd.stats.onAbortLoad();
+                    continue;
+                }
+                break;
+            }
+            const bool isReadOnly = tl_is_read_only && myopd.alog.size() == alogSize && myopd.rlog.empty();
+            if (isReadOnly) myopd.stats.onCommit(0, 0, 0);
+            tl_opdata = prevopd;
+            tl_is_read_only = prevro;
+            --myopd.nestedTrans;
+            he.clear(tid);
+            return isReadOnly;
+        }
+
+        // A transaction can be announced only if its result fits in the 64 bits of results[] and its lambda
+        // can be copied into a TransFunc and reclaimed without calling its destructor
+        template<typename R, typename F> static constexpr bool isCombinable() {
+            using FT = typename std::decay<F>::type;
+            if (!std::is_copy_constructible<FT>::value || !std::is_trivially_destructible<FT>::value) return false;
+            if constexpr (std::is_void<R>::value) return true;
+            else return sizeof(R) <= sizeof(uint64_t) && std::is_trivially_copyable<R>::value;
+        }
+
+        // Progress condition: wait-free bounded (by TX_BACKOFF_MAX)
+        // Called by transaction() after each failed attempt, to apply the contention management policy, which is
+        // driven by the number of consecutive aborts of the current transaction.
+        // Returns true if the transaction must be announced with combinedTransaction(), which is done only in
+        // the commit combining mode and in the hybrid mode, where the lambdas capture by value.
+        bool contentionAbort(OpData& myopd, const bool combinable, const int tid) {
+            const uint64_t aborts = ++myopd.aborts;
+            myopd.numAborts.store(myopd.numAborts.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+            const uint64_t hybrid = hybridAborts.load(std::memory_order_relaxed);
+            if (combinable && hybrid != 0 && aborts >= hybrid) {
+                myopd.numEscalations.store(myopd.numEscalations.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+                return true;
+            }
+            const ContentionPolicy cm = cmPolicy.load(std::memory_order_relaxed);
+            if (cm == CM_NONE) return false;
+            if (cm == CM_KARMA && aborts >= TX_KARMA_ABORTS) {
+                if (aborts == TX_KARMA_ABORTS) myopd.numEscalations.store(myopd.numEscalations.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+                if (combining && combinable) return true;
+                uint64_t prio = priorityTid.load(std::memory_order_acquire);
+                if (prio == NO_PRIORITY) priorityTid.compare_exchange_strong(prio, tid);
+                // The transaction with priority retries immediately
+                if (priorityTid.load(std::memory_order_acquire) == (uint64_t)tid) return false;
+            }
+            // Randomized exponential backoff, with a window of TX_BACKOFF_MIN*2^(aborts-1) pauses
+            if (myopd.backoffSeed == 0) myopd.backoffSeed = (tid+1)*0x9E3779B97F4A7C15ULL;
+            myopd.backoffSeed ^= myopd.backoffSeed >> 12;
+            myopd.backoffSeed ^= myopd.backoffSeed << 25;
+            myopd.backoffSeed ^= myopd.backoffSeed >> 27;
+            const uint64_t window = (aborts > 20) ? TX_BACKOFF_MAX : std::min(TX_BACKOFF_MIN << (aborts-1), TX_BACKOFF_MAX);
+            const uint64_t pauses = (myopd.backoffSeed * 2685821657736338717ULL) % window;
+            for (uint64_t i = 0; i < pauses; i++) _mm_pause();
+            return false;
+        }
+
+        // Progress condition: wait-free population oblivious
+        // Called by transaction() once the transaction has committed. Updates the counters and gives up the priority.
+        inline void contentionCommit(OpData& myopd, const int tid) {
+            if (myopd.aborts > myopd.maxAborts.load(std::memory_order_relaxed)) myopd.maxAborts.store(myopd.aborts, std::memory_order_relaxed);
+            myopd.numCommits.store(myopd.numCommits.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+            myopd.aborts = 0;
+            if (priorityTid.load(std::memory_order_relaxed) == (uint64_t)tid) priorityTid.store(NO_PRIORITY, std::memory_order_release);
+        }
+
+        // Progress condition: wait-free bounded (by TX_BACKOFF_MAX)
+        // With CM_KARMA, waits for the transaction that has priority (if any) to commit, but only for a bounded time,
+        // because the thread that has the priority may be sleeping.
+        inline void waitForPriority(const int tid) {
+            for (uint64_t i = 0; i < TX_BACKOFF_MAX; i++) {
+                const uint64_t prio = priorityTid.load(std::memory_order_acquire);
+                if (prio == NO_PRIORITY || prio == (uint64_t)tid) return;
+                _mm_pause();
+            }
+        }
+
+        // Progress condition: lock-free
+        // Announces our transaction in operations[tid] and executes combineAll() until our transaction is
+        // committed, either by us or by another thread, and then places its result in 'retval'.
+        template<typename R, typename F, typename RV> void combinedTransaction(OpData& myopd, F&& func, const int tid, RV& retval) {
+            using FT = typename std::decay<F>::type;
+            // We need an era from before 'funcptr' is announced, so as to protect it
+            const uint64_t firstEra = trans2seq(curTx.load(std::memory_order_acquire));
+            TransFuncOf<R,FT>* funcptr = (TransFuncOf<R,FT>*)tl_cache.allocate(sizeof(TransFuncOf<R,FT>));
+            new (funcptr) TransFuncOf<R,FT>(func);
+            operations[tid].rawStore((uint64_t)static_cast<TransFunc*>(funcptr), results[tid].getSeq());
+            numAnnounced.fetch_add(1);
+            while (results[tid].getSeq() <= operations[tid].getSeq()) {
+                beginTx(myopd, tid);
+                // beginTx() applies the last transaction, which may have been the one with our result
+                if (results[tid].getSeq() > operations[tid].getSeq()) break;
+                try {
+                    combineAll(myopd);
+                } catch (AbortedTx&) {
+                    myopd.stats.onAbortLoad();
+                    continue;
+                }
+                commitTx(myopd, tid);
+            }
+            numAnnounced.fetch_sub(1);
+            // The result is stable until our next announcement
+            uint64_t res, resSeq;
+            results[tid].rawLoad(res, resSeq);
+            // Results larger than 64 bits are never announced (see isCombinable()), but this is still instantiated for them
+            if constexpr (!std::is_void<R>::value) {
+                if constexpr (sizeof(R) <= sizeof(uint64_t)) std::memcpy(&retval, &res, sizeof(R));
+            }
+            // Other threads may still be executing (and then aborting) our lambda
+            funcptr->newEra_ = firstEra;
+            funcptr->delEra_ = trans2seq(curTx.load(std::memory_order_acquire))+1;
+            he.addToRetiredList(funcptr, tid);
+        }
+
+        // Executes the announced transactions of all threads as part of the current transaction,
+        // storing each result in results[] with a store that is part of the same transaction.
+        // We check curTx after reading operations[i] to make sure the TransFunc is protected by our era.
+        inline void combineAll(OpData& myopd) {
+            for (unsigned i = 0; i < ThreadRegistry::getMaxThreads(); i++) {
+                uint64_t txfunc, res, operationsSeq, resultSeq;
+                if (!operations[i].rawLoad(txfunc, operationsSeq)) continue;
+                if (!results[i].rawLoad(res, resultSeq)) continue;
+                if (resultSeq > operationsSeq) continue;
+                if (myopd.curTx != curTx.load(std::memory_order_acquire)) throw AbortedTxException;
+                res = ((TransFunc*)txfunc)->call((TransFunc*)txfunc);
+                myopd.writeSet.addOrReplace(&results[i], res);
+            }
+        }
+
+        // Progress condition: wait-free population oblivious
+        void helpApply(uint64_t lcurTx, const uint64_t tid) {
+            const uint64_t idx = trans2idx(lcurTx);
+            const uint64_t seq = trans2seq(lcurTx);
+            OpData* const opdp = opData[idx].load(std::memory_order_acquire);
+            // No transaction was ever done by thread idx (can only happen for the initial curTx)
+            if (opdp == nullptr) return;
+            OpData& opd = *opdp;
+            OpData& myopd = *opData[tid].load(std::memory_order_relaxed);
+            WriteSet& myws = myopd.writeSet;
+            // Nothing to apply unless the request matches the curTx
             if (lcurTx != opd.request.load(std::memory_order_acquire)) return;
+            if (idx != tid) {
+                // Use HE to protect the objects the transaction touches, including the chunks of the write-set
+                he.set(lcurTx, tid);
+                if (lcurTx != curTx.load()) return;
+            }
+            uint64_t copied = 0;
+            if (!cooperativeApply(opd, lcurTx, copied)) {
+                if (idx != tid) {
+                    // Make a copy of the write-set and check if it is consistent
+                    myws = opd.writeSet;
+                    copied += myws.numStores;
+                    // The published era is now protecting all objects alive in the transaction lcurTx
+                    if (lcurTx != opd.request.load(std::memory_order_acquire)) return;
+                }
+                if (debug) printf("Applying %ld stores in write-set\n", myws.numStores);
+                myws.apply(seq, tid);
+            }
+            if (idx != tid) myopd.stats.onHelp(copied*sizeof(WriteSetEntry));
+            const uint64_t newReq = seqidx2trans(seq+1,idx);
+            if (idx == tid) {
+                opd.request.store(newReq, std::memory_order_release);
+            } else {
+                if (opd.request.load(std::memory_order_acquire) == lcurTx) {
+                    opd.request.compare_exchange_strong(lcurTx, newReq);
+                }
+            }
         }
-        if (debug) printf("Applying %ld stores in write-set\n", writeSets[tid].numStores);
-        writeSets[tid].apply(seq, tid);
-        const uint64_t newReq = seqidx2trans(seq+1,idx);
-        if (idx == tid) {
-            opd.request.store(newReq, std::memory_order_release);
-        } else {
-            if (opd.request.load(std::memory_order_acquire) == lcurTx) {
-                opd.request.compare_exchange_strong(lcurTx, newReq);
+
+        // Progress condition: lock-free
+        // Applies a large write-set together with the other threads helping it: the log is split in ranges of
+        // TX_APPLY_STORES entries, and each thread claims the next range with a CAS on opd.applyNext, copies the
+        // range, checks that the request is still open, and applies it. This way, each entry is (usually) applied
+        // by a single thread, instead of having all threads copy and apply the whole log.
+        // Returns true if all the ranges have been applied. Returns false if the write-set is small, if the request
+        // is no longer open, or if a thread has claimed a range but not yet applied it (it may be sleeping), in which
+        // case the caller must do a full pass over the log.
+        // The number of entries copied by this thread is added to 'copied'.
+        bool cooperativeApply(OpData& opd, const uint64_t lcurTx, uint64_t& copied) {
+            const uint64_t numStores = opd.writeSet.numStores;
+            const uint64_t numRanges = (numStores + TX_APPLY_STORES - 1)/TX_APPLY_STORES;
+            if (numRanges < MIN_APPLY_RANGES || numRanges > APPLY_MASK) return false;
+            const uint64_t seq = trans2seq(lcurTx);
+            const uint64_t tag = seq << APPLY_SHIFT;
+            WriteSetEntry range[TX_APPLY_STORES];
+            while (true) {
+                uint64_t next = opd.applyNext.load(std::memory_order_acquire);
+                if ((next & ~APPLY_MASK) != tag) return false;
+                const uint64_t irange = next & APPLY_MASK;
+                if (irange >= numRanges) break;
+                if (!opd.applyNext.compare_exchange_strong(next, next+1)) continue;
+                const uint64_t from = irange*TX_APPLY_STORES;
+                const uint64_t to = std::min(from+TX_APPLY_STORES, numStores);
+                if (!opd.writeSet.copyEntries(from, to, range)) return false;
+                copied += to-from;
+                if (lcurTx != opd.request.load(std::memory_order_acquire)) return false;
+                for (uint64_t i = 0; i < to-from; i++) {
+                    if (TX_PREFETCH_DISTANCE != 0 && i+TX_PREFETCH_DISTANCE < to-from) __builtin_prefetch(range[i+TX_PREFETCH_DISTANCE].addr, 1);
+                    WriteSet::applyEntry(range[i], seq);
+                }
+                // Don't use fetch_add() because it could increment the counter of the next request
+                uint64_t done = opd.applyDone.load(std::memory_order_acquire);
+                while ((done & ~APPLY_MASK) == tag && !opd.applyDone.compare_exchange_weak(done, done+1));
             }
+            return opd.applyDone.load(std::memory_order_acquire) == (tag | numRanges);
         }
-    }
 
-    // This is called when the transaction fails, to undo all the allocations done during the transaction
-     void deleteAllocsFromLog(OpData& myopd) {
-        for (unsigned i = 0; i < myopd.numAllocs; i++) {
-            myopd.alog[i].reclaim(myopd.alog[i].obj);
+        // This is called when the transaction fails, to undo all the allocations done during the transaction
+         void deleteAllocsFromLog(OpData& myopd) {
+            for (Deletable& del : myopd.alog) del.reclaim(del.obj);
+            myopd.alog.clear();
         }
-        myopd.numAllocs = 0;
-    }
 
-    // My transaction was successful, it's my duty to cleanup any retired objects.
-    // This is called by the owner thread when the transaction succeeds, to pass
-    // the retired objects to Hazard Eras. We can't delete the objects
-    // immediately because there might be other threads trying to apply our log
-    // which may (or may not) contain addresses inside the objects in this list.
-    void retireRetiresFromLog(OpData& myopd, const int tid) {
-        uint64_t lseq = trans2seq(curTx.load(std::memory_order_acquire));
-        // First, add all the objects to the list of retired/zombies
-        for (unsigned i = 0; i < myopd.numRetires; i++) {
-            myopd.rlog[i]->delEra_ = lseq;
-            he.addToRetiredList(myopd.rlog[i], tid);
-        }
-        // Second, start a cleaning phase, scanning to see which objects can be removed
-        he.clean(lseq, tid);
-        myopd.numRetires = 0;
-    }
-};
+        // My transaction was successful, it's my duty to cleanup any retired objects.
+        // This is called by the owner thread when the transaction succeeds, to pass
+        // the retired objects to Hazard Eras. We can't delete the objects
+        // immediately because there might be other threads trying to apply our log
+        // which may (or may not) contain addresses inside the objects in this list.
+        void retireRetiresFromLog(OpData& myopd, const int tid) {
+            uint64_t lseq = trans2seq(curTx.load(std::memory_order_acquire));
+            // First, add all the objects to the list of retired/zombies
+            for (tmbase* del : myopd.rlog) {
+                del->delEra_ = lseq;
+                he.addToRetiredList(del, tid);
+            }
+            // Second, start a cleaning phase, scanning to see which objects can be removed
+            he.clean(lseq, tid);
+            myopd.rlog.clear();
+        }
+    };
 
 
-// T is typically a pointer to a node, but it can be integers or other stuff, as long as it fits in 64 bits
-template<typename T> struct tmtype : tmtypebase<T> {
+    // T is typically a pointer to a node, but it can be integers or other stuff, as long as it fits in 64 bits
+    template<typename T> struct tmtype : tmtypebase<T> {
 
-    tmtype() { }
+        tmtype() { }
 
-    tmtype(T initVal) { isolated_store(initVal); }
+        tmtype(T initVal) { isolated_store(initVal); }
 
-    // Casting operator
-    operator T() { return pload(); }
+        // Casting operator
+        operator T() { return pload(); }
 
-    // Prefix increment operator: ++x
-    void operator++ () { pstore(pload()+1); }
-    // Prefix decrement operator: --x
-    void operator-- () { pstore(pload()-1); }
-    void operator++ (int) { pstore(pload()+1); }
-    void operator-- (int) { pstore(pload()-1); }
+        // Prefix increment operator: ++x
+        void operator++ () { pstore(pload()+1); }
+        // Prefix decrement operator: --x
+        void operator-- () { pstore(pload()-1); }
+        void operator++ (int) { pstore(pload()+1); }
+        void operator-- (int) { pstore(pload()-1); }
 
-    // Equals operator: first downcast to T and then compare
-    bool operator == (const T& otherval) const { return pload() == otherval; }
+        // Equals operator: first downcast to T and then compare
+        bool operator == (const T& otherval) const { return pload() == otherval; }
 
-    // Difference operator: first downcast to T and then compare
-    bool operator != (const T& otherval) const { return pload() != otherval; }
+        // Difference operator: first downcast to T and then compare
+        bool operator != (const T& otherval) const { return pload() != otherval; }
 
-    // Relational operators
-    bool operator < (const T& rhs) { return pload() < rhs; }
-    bool operator > (const T& rhs) { return pload() > rhs; }
-    bool operator <= (const T& rhs) { return pload() <= rhs; }
-    bool operator >= (const T& rhs) { return pload() >= rhs; }
+        // Relational operators
+        bool operator < (const T& rhs) { return pload() < rhs; }
+        bool operator > (const T& rhs) { return pload() > rhs; }
+        bool operator <= (const T& rhs) { return pload() <= rhs; }
+        bool operator >= (const T& rhs) { return pload() >= rhs; }
 
-    // Operator arrow ->
-    T operator->() { return pload(); }
+        // Operator arrow ->
+        T operator->() { return pload(); }
 
-    // Copy constructor
-    tmtype<T>(const tmtype<T>& other) { pstore(other.pload()); }
+        // Copy constructor
+        tmtype<T>(const tmtype<T>& other) { pstore(other.pload()); }
 
-    // Assignment operator from an tmtype
-    tmtype<T>& operator=(const tmtype<T>& other) {
-        pstore(other.pload());
-        return *this;
-    }
+        // Assignment operator from an tmtype
+        tmtype<T>& operator=(const tmtype<T>& other) {
+            pstore(other.pload());
+            return *this;
+        }
 
-    // Assignment operator from a value
-    tmtype<T>& operator=(T value) {
-        pstore(value);
-        return *this;
-    }
+        // Assignment operator from a value
+        tmtype<T>& operator=(T value) {
+            pstore(value);
+            return *this;
+        }
 
-    // Operator &
-    T* operator&() {
-        return (T*)this;
-    }
+        // Operator &
+        T* operator&() {
+            return (T*)this;
+        }
+
+        // Meant to be called when know we're the only ones touching
+        // these contents, for example, in the constructor of an object, before
+        // making the object visible to other threads.
+        inline void isolated_store(T newVal) {
+            tmtypebase<T>::val.store((uint64_t)newVal, std::memory_order_relaxed);
+        }
+
+        // We don't need to check currTx here because we're not de-referencing
+        // the val. It's only after a load() that the val may be de-referenced
+        // (in user code), therefore we do the check on load() only.
+        inline void pstore(T newVal) {
+            OpData* const myopd = tl_opdata;
+            if (myopd == nullptr) { // Looks like we're outside a transaction
+                tmtypebase<T>::val.store((uint64_t)newVal, std::memory_order_relaxed);
+            } else if (myopd->isCaptured(this)) { // Allocated in this transaction, no one else can see it
+                tmtypebase<T>::val.store((uint64_t)newVal, std::memory_order_relaxed);
+            } else {
+                myopd->writeSet.addOrReplace(this, (uint64_t)newVal);
+            }
+        }
+
+        // We have to check if there is a new ongoing transaction and if so, abort
+        // this execution immediately for two reasons:
+        // 1. Memory Reclamation: the val we're returning may be a pointer to an
+        // object that has since been retired and deleted, therefore we can't allow
+        // user code to de-reference it;
+        // 2. Invariant Conservation: The val we're reading may be from a newer
+        // transaction, which implies that it may break an invariant in the user code.
+        // See examples of invariant breaking in this post:
+        // http://concurrencyfreaks.com/2013/11/stampedlocktryoptimisticread-and.html
+        inline T pload() const {
+            T lval = (T)tmtypebase<T>::val.load(std::memory_order_acquire);
+            if (tl_opdata == nullptr) return lval;
+            uint64_t lseq = tmtypebase<T>::seq.load(std::memory_order_acquire);
+            if (lseq > trans2seq(tl_opdata->curTx)) {
+                if (TX_PROFILE && ConflictProfiler::sample()) {
+                    gConflictProfiler.onAbort(this, tl_opdata->writeSet.numStores, tl_opdata->writeSet.contains(this));
+                }
+                throw AbortedTxException;
+            }
+            if (tl_is_read_only) return lval;
+            return (T)tl_opdata->writeSet.lookupAddr(this, (uint64_t)lval);
+        }
+    };
+
+
+    // A 64 bit counter for sizes, statistics and sequence numbers, which many transactions update and few read.
+    // Updating the counter doesn't load it, so it doesn't need the counter to be unmodified since the transaction
+    // started: the deltas of a transaction are summed in a single entry of the write-set, which commitTx() turns
+    // into a store of the final value (see WriteSet::foldDeltas()). The counter is loaded and its 'seq' validated
+    // only if the transaction reads it, with pload().
+    struct tmcounter : tmtypebase<uint64_t> {
+        tmcounter() { }
+
+        tmcounter(uint64_t initVal) { isolated_store(initVal); }
+
+        // Casting operator
+        operator uint64_t() { return pload(); }
+
+        // Increment and decrement operators
+        void operator++ () { add(1); }
+        void operator-- () { add(-1); }
+        void operator++ (int) { add(1); }
+        void operator-- (int) { add(-1); }
+        tmcounter& operator+=(int64_t delta) { add(delta); return *this; }
+        tmcounter& operator-=(int64_t delta) { add(-delta); return *this; }
+
+        // Meant to be called when know we're the only ones touching the counter,
+        // for example, in the constructor of an object, before making the object
+        // visible to other threads.
+        inline void isolated_store(uint64_t newVal) {
+            val.store(newVal, std::memory_order_relaxed);
+        }
+
+        // Adds 'delta' (which can be negative) to the counter, without loading it
+        inline void add(int64_t delta) {
+            OpData* const myopd = tl_opdata;
+            if (myopd == nullptr) { // Looks like we're outside a transaction
+                val.store(val.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+            } else if (myopd->isCaptured(this)) { // Allocated in this transaction, no one else can see it
+                val.store(val.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+            } else {
+                myopd->writeSet.addDelta(this, (uint64_t)delta);
+            }
+        }
+
+        // Adds 'delta' to the counter and returns its previous value, to generate sequence numbers.
+        // Unlike add(), this loads the counter.
+        inline uint64_t fetchAdd(int64_t delta) {
+            const uint64_t prev = pload();
+            add(delta);
+            return prev;
+        }
+
+        // Same as tmtype::pload(), plus the deltas of the current transaction
+        inline uint64_t pload() const {
+            uint64_t lval = val.load(std::memory_order_acquire);
+            OpData* const myopd = tl_opdata;
+            if (myopd == nullptr) return lval;
+            uint64_t lseq = seq.load(std::memory_order_acquire);
+            if (lseq > trans2seq(myopd->curTx)) {
+                if (TX_PROFILE && ConflictProfiler::sample()) {
+                    gConflictProfiler.onAbort(this, myopd->writeSet.numStores, myopd->writeSet.contains(this));
+                }
+                throw AbortedTxException;
+            }
+            if (tl_is_read_only) return lval;
+            return myopd->writeSet.lookupCounter(this, lval);
+        }
+    };
 
-    // Meant to be called when know we're the only ones touching
-    // these contents, for example, in the constructor of an object, before
-    // making the object visible to other threads.
-    inline void isolated_store(T newVal) {
-        tmtypebase<T>::val.store((uint64_t)newVal, std::memory_order_relaxed);
+
+    //
+    // Wrapper methods to the TM instance of this configuration. The user should use these:
+    //
+    template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
+    template<typename R, typename F> static R readTx(F&& func) { return gOFLF.readTransaction<R>(func); }
+    template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
+    template<typename F> static void readTx(F&& func) { gOFLF.readTransaction(func); }
+    template<typename T, typename... Args> static T* tmNew(Args&&... args) { return OneFileLF::template tmNew<T>(args...); }
+    template<typename T> static void tmDelete(T* obj) { OneFileLF::template tmDelete<T>(obj); }
+    static inline void* tmMalloc(size_t size) { return OneFileLF::tmMalloc(size); }
+    static inline void tmFree(void* obj) { OneFileLF::tmFree(obj); }
+
+
+    //
+    // Transactional objects of up to a cache line, for multi-word values like a key-value pair or the fields of a fat node
+    //
+
+    // A tmobject holds a trivially copyable T of up to 64 bytes in an immutable box, and a store replaces the box with a
+    // new one. Loading the object validates a single 'seq' (of the pointer to the box) and storing it takes a single entry
+    // in the write-set, instead of one per word with a tmtype for each word.
+    // The box of a store is not visible to other threads until the transaction commits, therefore, further stores to
+    // the same object in the transaction overwrite it in place.
+    // The previous box is retired with tmDelete(), which keeps it alive while older transactions may still be reading it.
+    // There is no destructor, because it would also run when the allocation of the object is rolled back, after the box
+    // was already freed with it. Instead, call reset() before deleting the object that contains a tmobject, otherwise its
+    // box leaks.
+    template<typename T> struct tmobject {
+        static_assert(std::is_trivially_copyable<T>::value, "tmobject<T> requires a trivially copyable T");
+        static_assert(sizeof(T) <= 64, "tmobject<T> is meant for types of up to 64 bytes");
+
+        struct Box : public tmbase {
+            T obj;
+            Box(const T& initVal) : obj{initVal} { }
+        };
+
+        tmtype<Box*> box {nullptr};
+
+        tmobject() { }
+
+        tmobject(const T& initVal) { pstore(initVal); }
+
+        // Copy constructor: copies the value, not the box
+        tmobject(const tmobject& other) { pstore(other.pload()); }
+
+        // Casting operator
+        operator T() const { return pload(); }
+
+        // Assignment operator from a tmobject
+        tmobject& operator=(const tmobject& other) {
+            pstore(other.pload());
+            return *this;
+        }
+
+        // Assignment operator from a value
+        tmobject& operator=(const T& value) {
+            pstore(value);
+            return *this;
+        }
+
+        // Returns a copy of the object, or a value-initialized T if nothing was stored yet
+        inline T pload() const {
+            const Box* const lbox = box.pload();
+            return (lbox == nullptr) ? T{} : lbox->obj;
+        }
+
+        // Outside a transaction, or if the box was created by the current transaction, the object is overwritten in place
+        inline void pstore(const T& newVal) {
+            OpData* const myopd = tl_opdata;
+            Box* const lbox = box.pload();
+            if (lbox != nullptr && (myopd == nullptr || myopd->isCaptured(lbox, sizeof(Box)) ||
+                                                      myopd->writeSet.lookupAddr(&box, 0) == (uint64_t)lbox)) {
+                lbox->obj = newVal;
+                return;
+            }
+            Box* const nbox = tmNew<Box>(newVal);
+            box = nbox;
+            tmDelete(lbox);
+        }
+
+        // Retires the box, after which the object loads as a value-initialized T
+        inline void reset() {
+            Box* const lbox = box.pload();
+            if (lbox == nullptr) return;
+            box = nullptr;
+            tmDelete(lbox);
+        }
+    };
+
+
+    //
+    // Bulk stores over arrays of tmtypes, which check the transaction once for the whole array instead of once per element.
+    // Inside a transaction, an array allocated in the same transaction is written in place (see OpData::isCaptured()),
+    // otherwise each element goes to the write-set, like with a store.
+    //
+
+    // Stores 'val' in the 'n' elements of 'dst'
+    template<typename T> static void tmMemset(tmtype<T>* dst, T val, size_t n) {
+        OpData* const myopd = tl_opdata;
+        if (myopd == nullptr || myopd->isCaptured(dst, n*sizeof(tmtype<T>))) {
+            for (size_t i = 0; i < n; i++) dst[i].isolated_store(val);
+        } else {
+            for (size_t i = 0; i < n; i++) myopd->writeSet.addOrReplace(dst+i, (uint64_t)val);
+        }
     }
 
-    // We don't need to check currTx here because we're not de-referencing
-    // the val. It's only after a load() that the val may be de-referenced
-    // (in user code), therefore we do the check on load() only.
-    inline void pstore(T newVal) {
+    // Copies 'n' values from (non-transactional) memory at 'src' to the elements of 'dst'
+    template<typename T> static void tmMemcpy(tmtype<T>* dst, const T* src, size_t n) {
         OpData* const myopd = tl_opdata;
-        if (myopd == nullptr) { // Looks like we're outside a transaction
-            tmtypebase<T>::val.store((uint64_t)newVal, std::memory_order_relaxed);
+        if (myopd == nullptr || myopd->isCaptured(dst, n*sizeof(tmtype<T>))) {
+            for (size_t i = 0; i < n; i++) dst[i].isolated_store(src[i]);
         } else {
-            gOFLF.writeSets[tl_tcico.tid].addOrReplace(this, (uint64_t)newVal);
+            for (size_t i = 0; i < n; i++) myopd->writeSet.addOrReplace(dst+i, (uint64_t)src[i]);
         }
     }
 
-    // We have to check if there is a new ongoing transaction and if so, abort
-    // this execution immediately for two reasons:
-    // 1. Memory Reclamation: the val we're returning may be a pointer to an
-    // object that has since been retired and deleted, therefore we can't allow
-    // user code to de-reference it;
-    // 2. Invariant Conservation: The val we're reading may be from a newer
-    // transaction, which implies that it may break an invariant in the user code.
-    // See examples of invariant breaking in this post:
-    // http://concurrencyfreaks.com/2013/11/stampedlocktryoptimisticread-and.html
-    inline T pload() const {
-        T lval = (T)tmtypebase<T>::val.load(std::memory_order_acquire);
-        if (tl_opdata == nullptr) return lval;
-        uint64_t lseq = tmtypebase<T>::seq.load(std::memory_order_acquire);
-        if (lseq > trans2seq(tl_opdata->curTx)) throw AbortedTxException;
-        if (tl_is_read_only) return lval;
-        return (T)gOFLF.writeSets[tl_tcico.tid].lookupAddr(this, (uint64_t)lval);
+    // Copies the 'n' elements of 'src' to the elements of 'dst'. The arrays may overlap, like in std::memmove().
+    template<typename T> static void tmCopyArray(tmtype<T>* dst, const tmtype<T>* src, size_t n) {
+        OpData* const myopd = tl_opdata;
+        const bool inPlace = (myopd == nullptr || myopd->isCaptured(dst, n*sizeof(tmtype<T>)));
+        for (size_t j = 0; j < n; j++) {
+            const size_t i = (dst > src) ? n-1-j : j;
+            const T lval = src[i].pload();
+            if (inPlace) dst[i].isolated_store(lval);
+            else myopd->writeSet.addOrReplace(dst+i, (uint64_t)lval);
+        }
     }
-};
 
 
-//
-// Wrapper methods to the global TM instance. The user should use these:
-//
-template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
-template<typename R, typename F> static R readTx(F&& func) { return gOFLF.transaction<R>(func); }
-template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
-template<typename F> static void readTx(F&& func) { gOFLF.transaction(func); }
-template<typename T, typename... Args> T* tmNew(Args&&... args) { return OneFileLF::tmNew<T>(args...); }
-template<typename T> void tmDelete(T* obj) { OneFileLF::tmDelete<T>(obj); }
-inline void* tmMalloc(size_t size) { return OneFileLF::tmMalloc(size); }
-inline void tmFree(void* obj) { OneFileLF::tmFree(obj); }
+    // The instances of this configuration, in a single object so that they are constructed in this order and destroyed
+    // in the reverse order. The profiler is destroyed after the engine, because the destructor of the engine frees objects.
+    struct Globals {
+        ConflictProfiler  conflictProfiler {"OneFileLF"};
+        OneFileLF         engine {};
+        ThreadRegistry    threadRegistry {};
+    };
+    static Globals globals;
+};
 
 
 //
-// Place these in a .cpp if you include this header from different files (compilation units)
+// Static members of the engine
 //
-OneFileLF gOFLF {};
-thread_local OpData* tl_opdata {nullptr};
+template<typename Config> ConflictProfiler& Engine<Config>::gConflictProfiler = Engine<Config>::globals.conflictProfiler;
+template<typename Config> typename Engine<Config>::OneFileLF& Engine<Config>::gOFLF = Engine<Config>::globals.engine;
+template<typename Config> thread_local typename Engine<Config>::OpData* Engine<Config>::tl_opdata {nullptr};
 // Global/singleton to hold all the thread registry functionality
-ThreadRegistry gThreadRegistry {};
+template<typename Config> typename Engine<Config>::ThreadRegistry& Engine<Config>::gThreadRegistry = Engine<Config>::globals.threadRegistry;
 // During a transaction, this is true up until the first store()
-thread_local bool tl_is_read_only {false};
+template<typename Config> thread_local bool Engine<Config>::tl_is_read_only {false};
+// Free blocks of tmNew() and tmMalloc() of each thread
+template<typename Config> thread_local typename Engine<Config>::AllocCache Engine<Config>::tl_cache;
 // This is where every thread stores the tid it has been assigned when it calls getTID() for the first time.
 // When the thread dies, the destructor of ThreadCheckInCheckOut will be called and de-register the thread.
-thread_local ThreadCheckInCheckOut tl_tcico {};
+template<typename Config> thread_local typename Engine<Config>::ThreadCheckInCheckOut Engine<Config>::tl_tcico {};
 // Helper function for thread de-registration
-void thread_registry_deregister_thread(const int tid) {
+template<typename Config> void Engine<Config>::thread_registry_deregister_thread(const int tid) {
+    tl_cache.flush();
     gThreadRegistry.deregister_thread(tid);
 }
+// The instances of the other configurations are constructed with the dynamic initialization of the program,
+// in no particular order with the globals of the user
+template<typename Config> typename Engine<Config>::Globals Engine<Config>::globals {};
+
+
+//
+// Place these in a .cpp if you include this header from different files (compilation units)
+//
+// The instances of the default configuration are constructed before the globals that follow the include of this header
+template<> Engine<DefaultConfig>::Globals Engine<DefaultConfig>::globals {};
+
+
+//
+// The engine with the default configuration. These are the names used by the benchmarks, and by the data structures
+// that aren't given a configuration.
+//
+typedef Engine<DefaultConfig>::OneFileLF OneFileLF;
+typedef Engine<DefaultConfig>::ThreadRegistry ThreadRegistry;
+typedef Engine<DefaultConfig>::WriteSet WriteSet;
+typedef Engine<DefaultConfig>::tmcounter tmcounter;
+template<typename T> using tmtype = Engine<DefaultConfig>::tmtype<T>;
+template<typename T> using tmobject = Engine<DefaultConfig>::tmobject<T>;
+static const int REGISTRY_MAX_THREADS = Engine<DefaultConfig>::REGISTRY_MAX_THREADS;
+inline OneFileLF& gOFLF = Engine<DefaultConfig>::gOFLF;
+
+// Wrapper methods to the default TM instance. The user should use these:
+template<typename R, typename F> static R updateTx(F&& func) { return gOFLF.transaction<R>(func); }
+template<typename R, typename F> static R readTx(F&& func) { return gOFLF.readTransaction<R>(func); }
+template<typename F> static void updateTx(F&& func) { gOFLF.transaction(func); }
+template<typename F> static void readTx(F&& func) { gOFLF.readTransaction(func); }
+template<typename T, typename... Args> T* tmNew(Args&&... args) { return OneFileLF::tmNew<T>(args...); }
+template<typename T> void tmDelete(T* obj) { OneFileLF::tmDelete<T>(obj); }
+inline void* tmMalloc(size_t size) { return OneFileLF::tmMalloc(size); }
+inline void tmFree(void* obj) { OneFileLF::tmFree(obj); }
+template<typename T> void tmMemset(tmtype<T>* dst, T val, size_t n) { Engine<DefaultConfig>::tmMemset(dst, val, n); }
+template<typename T> void tmMemcpy(tmtype<T>* dst, const T* src, size_t n) { Engine<DefaultConfig>::tmMemcpy(dst, src, n); }
+template<typename T> void tmCopyArray(tmtype<T>* dst, const tmtype<T>* src, size_t n) { Engine<DefaultConfig>::tmCopyArray(dst, src, n); }
 
 
+} // inline namespace OFLF_CONFIG_NS
 } // ... and all this with less than 800 lines of code  :)
 
 #endif /* _ONE_FILE_LOCK_FREE_TRANSACTIONAL_MEMORY_WITH_HAZARD_ERAS_H_ */